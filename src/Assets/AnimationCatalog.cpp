@@ -0,0 +1,191 @@
+#include "Assets/AnimationCatalog.h"
+#include <exception>
+using namespace std;
+
+namespace Alamo
+{
+
+// Checking is mostly waiting on the disk, so use more threads than processors
+static const size_t MAX_CHECK_THREADS = 16;
+
+struct AnimationCatalog::Job
+{
+    ptr<IFile> file;
+    size_t     index;   // Position in the caller's list
+    Header     header;
+};
+
+struct AnimationCatalog::JobQueue
+{
+    vector<Job>&     jobs;
+    volatile LONG    next;
+    CRITICAL_SECTION lock;
+    HANDLE           hDone;     // Signalled when jobs are added to done
+    vector<size_t>   done;      // Checked, but not yet reported
+    volatile LONG    failed;
+    exception_ptr    error;     // The first error on a checking thread
+};
+
+void AnimationCatalog::ReadHeader(const IFile& file, Header& header)
+{
+    header.fileSize = file.size();
+    header.valid    = Animation::ReadBones(file, header.bones);
+}
+
+bool AnimationCatalog::Matches(const Header& header, const Model& model)
+{
+    return header.valid && Animation::Probe(header.bones, model) == Animation::PROBE_COMPATIBLE;
+}
+
+DWORD WINAPI AnimationCatalog::CheckThread(LPVOID lpParam)
+{
+    JobQueue& queue = *(JobQueue*)lpParam;
+    LONG i;
+    while (queue.failed == 0 && (i = InterlockedIncrement(&queue.next) - 1) < (LONG)queue.jobs.size())
+    {
+        try
+        {
+            ReadHeader(*queue.jobs[i].file, queue.jobs[i].header);
+
+            // Has room for every job, so this doesn't allocate
+            EnterCriticalSection(&queue.lock);
+            queue.done.push_back(i);
+            LeaveCriticalSection(&queue.lock);
+        }
+        catch (...)
+        {
+            // Only the first error is kept; the calling thread rethrows it
+            if (InterlockedExchange(&queue.failed, 1) == 0)
+            {
+                queue.error = current_exception();
+            }
+        }
+
+        if (queue.hDone != NULL)
+        {
+            SetEvent(queue.hDone);
+        }
+    }
+    return 0;
+}
+
+void AnimationCatalog::Check(const vector< ptr<IFile> >& files, const Model& model, IListener& listener)
+{
+    // Report known files right away and queue the rest
+    vector<Job> jobs;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        map<wstring, Header>::const_iterator p = m_headers.find(files[i]->name());
+        if (p != m_headers.end() && p->second.fileSize == files[i]->size())
+        {
+            listener.OnAnimationChecked(i, Matches(p->second, model));
+        }
+        else
+        {
+            jobs.push_back(Job());
+            jobs.back().file  = files[i];
+            jobs.back().index = i;
+        }
+    }
+
+    if (jobs.empty())
+    {
+        return;
+    }
+
+    JobQueue queue = {jobs, 0};
+    queue.failed = 0;
+    queue.done.reserve(jobs.size());
+    InitializeCriticalSection(&queue.lock);
+    queue.hDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    // Without the event, this thread can't wait for others, so it does all the work
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    size_t nThreads = (queue.hDone == NULL) ? 1 : min(min((size_t)si.dwNumberOfProcessors * 2, MAX_CHECK_THREADS), jobs.size());
+
+    vector<HANDLE> hThreads;
+    for (size_t i = 1; i < nThreads; i++)
+    {
+        DWORD  ThreadID;
+        HANDLE hThread = CreateThread(NULL, 0, CheckThread, &queue, 0, &ThreadID);
+        if (hThread == NULL)
+        {
+            // Carry on with the threads we have
+            break;
+        }
+        hThreads.push_back(hThread);
+    }
+
+    // Stops handing out jobs and lets the threads finish before the queue goes away
+    auto finish = [&]() {
+        InterlockedExchange(&queue.next, (LONG)jobs.size());
+        if (!hThreads.empty())
+        {
+            WaitForMultipleObjects((DWORD)hThreads.size(), &hThreads[0], TRUE, INFINITE);
+            for (size_t i = 0; i < hThreads.size(); i++)
+            {
+                CloseHandle(hThreads[i]);
+            }
+        }
+        if (queue.hDone != NULL)
+        {
+            CloseHandle(queue.hDone);
+        }
+        DeleteCriticalSection(&queue.lock);
+    };
+
+    // Report results as they come in. This thread checks files as well,
+    // but only one at a time, so it can report in between.
+    vector<size_t> done;
+    size_t         nReported = 0;
+    try
+    {
+        done.reserve(jobs.size());
+        while (nReported < jobs.size())
+        {
+            LONG i = InterlockedIncrement(&queue.next) - 1;
+            if (i < (LONG)jobs.size())
+            {
+                ReadHeader(*jobs[i].file, jobs[i].header);
+                done.push_back(i);
+            }
+            else
+            {
+                WaitForSingleObject(queue.hDone, INFINITE);
+            }
+
+            if (queue.failed != 0)
+            {
+                // The error is only safe to read once the threads are done
+                break;
+            }
+
+            EnterCriticalSection(&queue.lock);
+            done.insert(done.end(), queue.done.begin(), queue.done.end());
+            queue.done.clear();
+            LeaveCriticalSection(&queue.lock);
+
+            for (size_t j = 0; j < done.size(); j++, nReported++)
+            {
+                const Job& job = jobs[done[j]];
+                m_headers[job.file->name()] = job.header;
+                listener.OnAnimationChecked(job.index, Matches(job.header, model));
+            }
+            done.clear();
+        }
+    }
+    catch (...)
+    {
+        finish();
+        throw;
+    }
+    finish();
+
+    if (queue.failed != 0)
+    {
+        rethrow_exception(queue.error);
+    }
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef ANIMATIONCATALOG_H
+#define ANIMATIONCATALOG_H
+
+#include "Assets/Animations.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Alamo
+{
+
+/*
+ * Finds out which animation files fit a model, without loading them. Only the
+ * bone names and indices at the start of each file are read, on several
+ * threads at once, and they are kept per file, so checking the same files
+ * again, against any model, does not touch them.
+ */
+class AnimationCatalog
+{
+public:
+    // Receives the results of Check(), on the thread that called it
+    class IListener
+    {
+    public:
+        /* Called once for every file, as soon as it has been checked; not
+         * necessarily in order. @index is the file's position in the list.
+         */
+        virtual void OnAnimationChecked(size_t index, bool compatible) = 0;
+    };
+
+    /* Checks every file against the model. The file cursors are not moved.
+     * Returns when all files have been reported to @listener.
+     */
+    void Check(const std::vector< ptr<IFile> >& files, const Model& model, IListener& listener);
+
+    /* Forgets all cached files */
+    void Clear() { m_headers.clear(); }
+
+private:
+    // The part of an animation file that decides what models it fits
+    struct Header
+    {
+        size_t                               fileSize;  // To notice changed files
+        bool                                 valid;
+        std::vector<Animation::AnimatedBone> bones;
+    };
+
+    struct Job;
+    struct JobQueue;
+
+    static DWORD WINAPI CheckThread(LPVOID lpParam);
+    static void ReadHeader(const IFile& file, Header& header);
+    static bool Matches(const Header& header, const Model& model);
+
+    std::map<std::wstring, Header> m_headers;
+};
+
+}
+
+#endif
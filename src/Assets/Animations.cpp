@@ -4,6 +4,7 @@
 #include "Assets/ChunkFile.h"
 #include "General/Exceptions.h"
 #include "General/Math.h"
+#include "General/PoseMath.h"
 #include "General/Log.h"
 #include "General/Utils.h"
 using namespace std;
@@ -11,35 +12,6 @@ using namespace std;
 namespace Alamo
 {
 
-#pragma pack(1)
-struct PackedQuaternion
-{
-    int16_t x, y, z, w;
-};
-
-struct PackedVector
-{
-    uint16_t x, y, z;
-};
-#pragma pack()
-
-struct Animation::BoneInfo
-{
-    size_t         index;
-    Vector3        ofsTrans, scaleTrans;
-    Vector3        ofsScale, scaleScale;
-    unsigned short idxTrans, idxScale, idxRot;
-    Quaternion     defRotation;
-};
-
-struct Animation::AnimationData
-{
-    size_t                   transBlockSize, rotBlockSize, scaleBlockSize;
-    Buffer<PackedVector>     transData;
-    Buffer<PackedVector>     scaleData;
-    Buffer<PackedQuaternion> rotData;
-};
-
 static Quaternion UnpackQuaternion(const PackedQuaternion& pq)
 {
     return Quaternion(pq.x / (float)INT16_MAX, pq.y / (float)INT16_MAX, pq.z / (float)INT16_MAX, pq.w / (float)INT16_MAX);
@@ -53,28 +25,28 @@ static Vector3 UnpackVector(const PackedVector& pv)
 static PackedQuaternion ReadPackedQuaternion(ChunkReader& reader)
 {
     PackedQuaternion pq;
-    pq.x = reader.readShort();
-    pq.y = reader.readShort();
-    pq.z = reader.readShort();
-    pq.w = reader.readShort();
+    reader.readArray(&pq.x, 4);
     return pq;
 }
 
-static PackedVector ReadPackedVector(ChunkReader& reader)
+// Reads a track of packed values for all frames into the interleaved data
+template <typename T, typename S>
+static void ReadPackedTrack(ChunkReader& reader, Buffer<T>& data, size_t blockSize, size_t index, unsigned long nFrames)
 {
-    PackedVector pv;
-    pv.x = reader.readShort();
-    pv.y = reader.readShort();
-    pv.z = reader.readShort();
-    return pv;
+    Buffer<T> track(nFrames);
+    reader.readArray((S*)(T*)track, nFrames * (sizeof(T) / sizeof(S)));
+    for (unsigned long i = 0; i < nFrames; i++)
+    {
+        data[i * blockSize + index] = track[i];
+    }
 }
 
-void Animation::ReadBone(ChunkReader& reader, int version, const Model& model, BoneInfo& info, AnimationData& data, size_t dataOffset, bool checkOnly)
+void Animation::ReadBone(ChunkReader& reader, int version, const Model& model, BoneInfo& info, size_t dataOffset, bool checkOnly)
 {
     Verify(reader.next() == 0x1002);
 
     Verify(reader.next() == 0x1003);
-    Verify(reader.nextMini() ==  4); string name = Uppercase(reader.readString());
+    Verify(reader.nextMini() ==  4); string name = reader.readString();
     Verify(reader.nextMini() ==  5); info.index  = reader.readInteger();
 
     // Verify that this bone matches the model's bone
@@ -116,10 +88,7 @@ void Animation::ReadBone(ChunkReader& reader, int version, const Model& model, B
             {
                 // Read translation data
                 info.idxTrans = (unsigned short)dataOffset;
-                for (unsigned long i = 0; i < m_nFrames; i++)
-                {
-                    data.transData[i * data.transBlockSize + info.idxTrans] = ReadPackedVector(reader);
-                }
+                ReadPackedTrack<PackedVector, uint16_t>(reader, m_data.transData, m_data.transBlockSize, info.idxTrans, m_nFrames);
             }
             type = reader.next();
         }
@@ -130,10 +99,7 @@ void Animation::ReadBone(ChunkReader& reader, int version, const Model& model, B
             {
                 // Read scale data
                 info.idxScale = (unsigned short)dataOffset;
-                for (unsigned long i = 0; i < m_nFrames; i++)
-                {
-                    data.scaleData[i * data.scaleBlockSize + info.idxScale] = ReadPackedVector(reader);
-                }
+                ReadPackedTrack<PackedVector, uint16_t>(reader, m_data.scaleData, m_data.scaleBlockSize, info.idxScale, m_nFrames);
             }
             type = reader.next();
         }
@@ -150,10 +116,7 @@ void Animation::ReadBone(ChunkReader& reader, int version, const Model& model, B
                 else
                 {
                     info.idxRot = (unsigned short)dataOffset;
-                    for (unsigned long i = 0; i < m_nFrames; i++)
-                    {
-                        data.rotData[i * data.rotBlockSize + info.idxRot] = ReadPackedQuaternion(reader);
-                    }
+                    ReadPackedTrack<PackedQuaternion, int16_t>(reader, m_data.rotData, m_data.rotBlockSize, info.idxRot, m_nFrames);
                 }
             }
             type = reader.next();
@@ -165,12 +128,7 @@ void Animation::ReadBone(ChunkReader& reader, int version, const Model& model, B
         if (!checkOnly)
         {
             // Read visibility data
-            Buffer<unsigned char> rawdata((m_nFrames + 7) / 8);
-            reader.read(rawdata, rawdata.size());
-            for (unsigned long i = 0; i < m_nFrames; i++)
-            {
-                m_frames[info.index * m_nFrames + i].visible = ((rawdata[i/8] >> (i % 8)) != 0);
-            }
+            reader.read(&m_visibility[info.index * m_visibilityStride], m_visibilityStride);
         }
         type = reader.next();
     }
@@ -184,12 +142,12 @@ void Animation::ReadBone(ChunkReader& reader, int version, const Model& model, B
     Verify(type == -1);
 }
 
-Animation::Animation(ptr<IFile> file, const Model& model, bool checkOnly)
+Animation::Animation(ptr<IFile> file, const Model& model, bool checkOnly, bool compressed)
+    : m_compressed(compressed)
 {
     ChunkReader reader(file);
     Verify(reader.next() == 0x1000);
 
-    AnimationData    data;
     vector<BoneInfo> bones;
     int version = 1;
 
@@ -208,62 +166,73 @@ Animation::Animation(ptr<IFile> file, const Model& model, bool checkOnly)
     if (type == 11)
     {
         // File format version #2
-        version = 2;                     data.rotBlockSize   = reader.readInteger() / (sizeof(PackedQuaternion) / sizeof(int16_t));
-        Verify(reader.nextMini() == 12); data.transBlockSize = reader.readInteger() / (sizeof(PackedVector) / sizeof(uint16_t));
-        Verify(reader.nextMini() == 13); data.scaleBlockSize = reader.readInteger() / (sizeof(PackedVector) / sizeof(uint16_t));
+        version = 2;                     m_data.rotBlockSize   = reader.readInteger() / (sizeof(PackedQuaternion) / sizeof(int16_t));
+        Verify(reader.nextMini() == 12); m_data.transBlockSize = reader.readInteger() / (sizeof(PackedVector) / sizeof(uint16_t));
+        Verify(reader.nextMini() == 13); m_data.scaleBlockSize = reader.readInteger() / (sizeof(PackedVector) / sizeof(uint16_t));
         type = reader.nextMini();
     }
     else
     {
         // File format version #1
-        data.rotBlockSize   = bones.size();
-        data.transBlockSize = bones.size();
-        data.scaleBlockSize = bones.size();
+        m_data.rotBlockSize   = bones.size();
+        m_data.transBlockSize = bones.size();
+        m_data.scaleBlockSize = bones.size();
     }
     Verify(type == -1);
 
     if (!checkOnly)
     {
         // Allocate buffers
-        data.rotData  .resize(data.rotBlockSize   * m_nFrames);
-        data.transData.resize(data.transBlockSize * m_nFrames);
-        data.scaleData.resize(data.scaleBlockSize * m_nFrames);
-
-        m_frames.resize(model.GetNumBones() * m_nFrames);
-        for (size_t i = 0; i < m_frames.size(); i++)
-        {
-            m_frames[i].visible = true;
-        }
+        m_data.rotData  .resize(m_data.rotBlockSize   * m_nFrames);
+        m_data.transData.resize(m_data.transBlockSize * m_nFrames);
+        m_data.scaleData.resize(m_data.scaleBlockSize * m_nFrames);
+
+        // Bones without visibility data are always visible
+        m_visibilityStride = (m_nFrames + 7) / 8;
+        m_visibility.resize(model.GetNumBones() * m_visibilityStride);
+        memset(m_visibility, 0xFF, m_visibility.size());
     }
 
     // Read the bone animations
     for (size_t i = 0; i < bones.size(); i++)
     {
-        ReadBone(reader, version, model, bones[i], data, i, checkOnly);
+        ReadBone(reader, version, model, bones[i], i, checkOnly);
     }
 
     if (!checkOnly)
     {
         if (version == 2)
         {
-            if (data.transBlockSize > 0)
+            if (m_data.transBlockSize > 0)
             {
                 // Read translation data
                 Verify(reader.next() == 0x100A);
-                reader.read(data.transData, data.transData.size() * sizeof(PackedVector));
+                reader.readArray((uint16_t*)(PackedVector*)m_data.transData, m_data.transData.size() * 3);
             }
             
-            if (data.rotBlockSize > 0)
+            if (m_data.rotBlockSize > 0)
             {
                 // Read rotation data
                 Verify(reader.next() == 0x1009);
-                reader.read(data.rotData, data.rotData.size() * sizeof(PackedQuaternion));
+                reader.readArray((int16_t*)(PackedQuaternion*)m_data.rotData, m_data.rotData.size() * 4);
             }
         }
 
         Verify(reader.next() == -1);
         
-        ConstructTransforms(model, bones, data);
+        if (m_compressed)
+        {
+            ConstructTracks(model, bones);
+        }
+        else
+        {
+            ConstructTransforms(model, bones);
+
+            // The tracks have been baked into the frames
+            m_data.transData.clear();
+            m_data.scaleData.clear();
+            m_data.rotData  .clear();
+        }
 
         // There are actually one less frames in the animation, the first is duplicated
         // at the end for easy looping.
@@ -271,8 +240,11 @@ Animation::Animation(ptr<IFile> file, const Model& model, bool checkOnly)
     }
 }
 
-void Animation::ConstructTransforms(const Model& model, const vector<BoneInfo>& bones, const AnimationData& data)
+void Animation::ConstructTransforms(const Model& model, const vector<BoneInfo>& bones)
 {
+    const AnimationData& data = m_data;
+    m_frames.resize(model.GetNumBones() * m_nFrames);
+
     // Construct the transform matrices for every frame for every bone in the model
     Buffer<Matrix> transforms(model.GetNumBones() * m_nFrames);
     
@@ -317,24 +289,28 @@ void Animation::ConstructTransforms(const Model& model, const vector<BoneInfo>&
         animated.insert(bone.index);
     }
 
-    for (size_t i = 0; i < model.GetNumBones(); i++)
+    // Walk the skeleton so that parents are made absolute before their children
+    const Model::Skeleton& skeleton = model.GetSkeleton();
+    for (size_t e = 0; e < model.GetNumBones(); e++)
     {
+        const size_t i = skeleton.bones[e];
         if (animated.find(i) == animated.end())
         {
             // Fill unanimated bones with default relative transforms
+            const Matrix rest(skeleton.scales[e], skeleton.rotations[e], skeleton.translations[e]);
             for (unsigned long f = 0; f < m_nFrames; f++)
             {
-                transforms[i * m_nFrames + f] = model.GetBone(i).relTransform;
+                transforms[i * m_nFrames + f] = rest;
             }
         }
 
         // Multiply transforms with parent transforms to get absolute transforms
-        const Model::Bone* parent = model.GetBone(i).parent;
-        if (parent != NULL)
+        if (skeleton.parents[e] != -1)
         {
+            const size_t parent = skeleton.bones[skeleton.parents[e]];
             for (unsigned long f = 0; f < m_nFrames; f++)
             {
-                transforms[i * m_nFrames + f] = transforms[i * m_nFrames + f] * transforms[parent->index * m_nFrames + f];
+                transforms[i * m_nFrames + f] = transforms[i * m_nFrames + f] * transforms[parent * m_nFrames + f];
             }
         }
 
@@ -347,8 +323,101 @@ void Animation::ConstructTransforms(const Model& model, const vector<BoneInfo>&
     }
 }
 
+void Animation::ConstructTracks(const Model& model, const vector<BoneInfo>& bones)
+{
+    const Model::Skeleton& skeleton = model.GetSkeleton();
+    m_tracks.resize(model.GetNumBones());
+    m_order .resize(model.GetNumBones());
+    for (size_t e = 0; e < model.GetNumBones(); e++)
+    {
+        const size_t i = skeleton.bones[e];
+        BoneTrack& track = m_tracks[i];
+        track.animated        = false;
+        track.restScale       = skeleton.scales[e];
+        track.restRotation    = skeleton.rotations[e];
+        track.restTranslation = skeleton.translations[e];
+        track.parent          = (skeleton.parents[e] != -1) ? skeleton.bones[skeleton.parents[e]] : -1;
+        m_order[e] = i;
+    }
+
+    for (size_t i = 0; i < bones.size(); i++)
+    {
+        BoneTrack& track = m_tracks[bones[i].index];
+        track.info     = bones[i];
+        track.animated = true;
+    }
+}
+
+// Decodes the bone's transform, relative to its parent, at a frame
+void Animation::DecodeFrame(size_t bone, size_t frame, Vector3& scale, Quaternion& rotation, Vector3& translation) const
+{
+    const BoneInfo& info = m_tracks[bone].info;
+    translation = info.ofsTrans;
+    scale       = info.ofsScale;
+    rotation    = info.defRotation;
+
+    if (info.idxTrans != UINT16_MAX)
+    {
+        translation += UnpackVector(m_data.transData[frame * m_data.transBlockSize + info.idxTrans]) * info.scaleTrans;
+    }
+
+    if (info.idxScale != UINT16_MAX)
+    {
+        scale += UnpackVector(m_data.scaleData[frame * m_data.scaleBlockSize + info.idxScale]) * info.scaleScale;
+    }
+
+    if (info.idxRot != UINT16_MAX)
+    {
+        rotation = UnpackQuaternion(m_data.rotData[frame * m_data.rotBlockSize + info.idxRot]);
+    }
+}
+
+// Decodes the bone's transform, relative to its parent, between two frames
+Matrix Animation::GetRelativeFrame(size_t bone, size_t frame, float s) const
+{
+    const BoneTrack& track = m_tracks[bone];
+    if (!track.animated)
+    {
+        return Matrix(track.restScale, track.restRotation, track.restTranslation);
+    }
+
+    Vector3    trans[2], scale[2];
+    Quaternion rot[2];
+    DecodeFrame(bone, frame,     scale[0], rot[0], trans[0]);
+    DecodeFrame(bone, frame + 1, scale[1], rot[1], trans[1]);
+    return Matrix(lerp(scale[0], scale[1], s), slerp(rot[0], rot[1], s), lerp(trans[0], trans[1], s));
+}
+
+bool Animation::GetVisibility(size_t bone, size_t frame) const
+{
+    return (m_visibility[bone * m_visibilityStride + frame / 8] >> (frame % 8)) != 0;
+}
+
+// Returns the frame at time @t, looping, and the fraction towards the next frame
+size_t Animation::GetFrameIndex(float t, float* s) const
+{
+    float  time = (m_nFrames > 0) ? fmod(t * m_fps, (float)m_nFrames) : 0.0f;
+    size_t f    = (size_t)time;
+    *s = time - f;
+    return f;
+}
+
 Matrix Animation::GetFrame(size_t bone, float t) const
 {
+    if (m_compressed)
+    {
+        float  s;
+        size_t f = GetFrameIndex(t, &s);
+
+        // Combine the relative transforms up to the root
+        Matrix transform = GetRelativeFrame(bone, f, s);
+        for (size_t parent = m_tracks[bone].parent; parent != -1; parent = m_tracks[parent].parent)
+        {
+            transform = transform * GetRelativeFrame(parent, f, s);
+        }
+        return transform;
+    }
+
     size_t f    = (m_nFrames > 0) ? ((size_t)(t * m_fps)) % m_nFrames : 0;
     size_t base = bone * (m_nFrames + 1);
     float  s = (t * m_fps) - f;
@@ -359,31 +428,88 @@ Matrix Animation::GetFrame(size_t bone, float t) const
         lerp (m_frames[f].translation, m_frames[f + 1].translation, s));
 }
 
+void Animation::EvaluatePose(float t, Matrix* pose) const
+{
+    // Gather both frames, then interpolate and build the matrices for all bones at once
+    PoseBuffer from, to;
+    if (m_compressed)
+    {
+        float  s;
+        size_t f = GetFrameIndex(t, &s);
+
+        from.resize(m_tracks.size());
+        to  .resize(m_tracks.size());
+        for (size_t i = 0; i < m_tracks.size(); i++)
+        {
+            const BoneTrack& track = m_tracks[i];
+            Vector3    scale, translation;
+            Quaternion rotation;
+            if (track.animated)
+            {
+                DecodeFrame(i, f,     scale, rotation, translation); from.set(i, scale, rotation, translation);
+                DecodeFrame(i, f + 1, scale, rotation, translation); to  .set(i, scale, rotation, translation);
+            }
+            else
+            {
+                from.set(i, track.restScale, track.restRotation, track.restTranslation);
+                to  .set(i, track.restScale, track.restRotation, track.restTranslation);
+            }
+        }
+        InterpolatePoses(from, to, s, from);
+        ComposePose(from, pose);
+
+        // Parents come first, so their transforms are already absolute
+        for (size_t e = 0; e < m_order.size(); e++)
+        {
+            const size_t i      = m_order[e];
+            const size_t parent = m_tracks[i].parent;
+            if (parent != -1)
+            {
+                pose[i] = pose[i] * pose[parent];
+            }
+        }
+    }
+    else
+    {
+        size_t f = (m_nFrames > 0) ? ((size_t)(t * m_fps)) % m_nFrames : 0;
+        float  s = (t * m_fps) - f;
+        const size_t nBones = m_frames.size() / (m_nFrames + 1);
+
+        from.resize(nBones);
+        to  .resize(nBones);
+        for (size_t i = 0, base = f; i < nBones; i++, base += m_nFrames + 1)
+        {
+            from.set(i, m_frames[base    ].scale, m_frames[base    ].rotation, m_frames[base    ].translation);
+            to  .set(i, m_frames[base + 1].scale, m_frames[base + 1].rotation, m_frames[base + 1].translation);
+        }
+        InterpolatePoses(from, to, s, from);
+        ComposePose(from, pose);
+    }
+}
+
 bool Animation::IsVisible(size_t bone, float t) const
 {
-    size_t f    = (m_nFrames > 0) ? ((size_t)(t * m_fps)) % m_nFrames : 0;
-    size_t base = bone * (m_nFrames + 1);
-    return m_frames[base + f].visible;
+    size_t f = (m_nFrames > 0) ? ((size_t)(t * m_fps)) % m_nFrames : 0;
+    return GetVisibility(bone, f);
 }
 
 float Animation::GetVisibleEvent(size_t bone, float from, float to) const
 {
     assert(from <= to);
-    size_t f1   = (size_t)ceil(from * m_fps);
-    size_t base = bone * (m_nFrames + 1);
+    size_t f1 = (size_t)ceil(from * m_fps);
     if (m_nFrames != 0)
     {
         size_t n = (size_t)max(floor(to * m_fps), f1) - f1;
         for (size_t f = 0; f <= n; f++)
         {
             size_t i = (f1 + f);
-            if (m_frames[base + (i % m_nFrames)].visible)
+            if (GetVisibility(bone, i % m_nFrames))
             {
                 return i / m_fps;
             }
         }
     }
-    else if (m_frames[base].visible)
+    else if (GetVisibility(bone, 0))
     {
         return 0.0f;
     }
@@ -393,25 +519,191 @@ float Animation::GetVisibleEvent(size_t bone, float from, float to) const
 float Animation::GetInvisibleEvent(size_t bone, float from, float to) const
 {
     assert(from <= to);
-    size_t f1   = (size_t)ceil(from * m_fps);
-    size_t base = bone * (m_nFrames + 1);
+    size_t f1 = (size_t)ceil(from * m_fps);
     if (m_nFrames != 0)
     {
         size_t n = (size_t)max(floor(to * m_fps), f1) - f1;
         for (size_t f = 0; f <= n; f++)
         {
             size_t i = (f1 + f);
-            if (!m_frames[base + (i % m_nFrames)].visible)
+            if (!GetVisibility(bone, i % m_nFrames))
             {
                 return i / m_fps;
             }
         }
     }
-    else if (!m_frames[base].visible)
+    else if (!GetVisibility(bone, 0))
     {
         return 0.0f;
     }
     return -1;
 }
 
-}
\ No newline at end of file
+//
+// Probing
+//
+
+/* Reads the header of the chunk at @pos, which must be a chunk of @type that
+ * ends before @end. Returns false if it is not.
+ */
+static bool ProbeChunk(const IFile& file, unsigned long pos, unsigned long end, uint32_t type, bool group, unsigned long* size)
+{
+    uint32_t hdr[2];
+    if (end - pos < CHUNK_HEADER_SIZE || file.readAt(pos, hdr, sizeof hdr) != sizeof hdr)
+    {
+        return false;
+    }
+    *size = letohl(hdr[1]) & 0x7FFFFFFF;
+    return letohl(hdr[0]) == type && ((letohl(hdr[1]) & 0x80000000) != 0) == group && *size <= end - pos - CHUNK_HEADER_SIZE;
+}
+
+// Reads the integer mini-chunk of @type at @data and moves past it
+static bool ProbeInteger(const unsigned char*& data, const unsigned char* end, unsigned char type, unsigned long* value)
+{
+    const unsigned long HEADER = MINI_CHUNK_HEADER_SIZE;
+    if (end - data < (ptrdiff_t)(HEADER + sizeof(uint32_t)) || data[0] != type || data[1] != sizeof(uint32_t))
+    {
+        return false;
+    }
+    uint32_t v;
+    memcpy(&v, data + HEADER, sizeof v);
+    *value = letohl(v);
+    data  += HEADER + sizeof(uint32_t);
+    return true;
+}
+
+// Reads the string mini-chunk of @type at @data and moves past it
+static bool ProbeString(const unsigned char*& data, const unsigned char* end, unsigned char type, string_view* value)
+{
+    const unsigned long HEADER = MINI_CHUNK_HEADER_SIZE;
+    if (end - data < (ptrdiff_t)HEADER || data[0] != type || data[1] > end - data - (ptrdiff_t)HEADER)
+    {
+        return false;
+    }
+    const char* str = (const char*)data + HEADER;
+    *value = string_view(str, strnlen(str, data[1]));
+    data  += HEADER + data[1];
+    return true;
+}
+
+/* Walks the animated bones at the start of an animation file, straight from
+ * the file, and passes their name and index to @visit until it returns false.
+ */
+template <typename Visitor>
+static Animation::ProbeResult ProbeBones(const IFile& file, Visitor visit)
+{
+    const unsigned long HEADER = CHUNK_HEADER_SIZE;
+
+    unsigned long size;
+    if (!ProbeChunk(file, 0, (unsigned long)file.size(), 0x1000, true, &size))
+    {
+        return Animation::PROBE_INVALID;
+    }
+    const unsigned long end = HEADER + size;
+    unsigned long       pos = HEADER;
+
+    // File information; only the number of bones matters here
+    unsigned char info[3 * (MINI_CHUNK_HEADER_SIZE + sizeof(uint32_t))];
+    if (!ProbeChunk(file, pos, end, 0x1001, false, &size) || size < sizeof info || file.readAt(pos + HEADER, info, sizeof info) != sizeof info)
+    {
+        return Animation::PROBE_INVALID;
+    }
+    pos += HEADER + size;
+
+    const unsigned char* p = info;
+    unsigned long nFrames, fps, nBones;
+    if (!ProbeInteger(p, info + sizeof info, 1, &nFrames) ||
+        !ProbeInteger(p, info + sizeof info, 2, &fps)     ||
+        !ProbeInteger(p, info + sizeof info, 3, &nBones))
+    {
+        return Animation::PROBE_INVALID;
+    }
+
+    for (unsigned long i = 0; i < nBones; i++)
+    {
+        // The name and index come first in the bone's information
+        unsigned long boneSize, dataSize;
+        if (!ProbeChunk(file, pos, end, 0x1002, true, &boneSize) ||
+            !ProbeChunk(file, pos + HEADER, pos + HEADER + boneSize, 0x1003, false, &dataSize))
+        {
+            return Animation::PROBE_INVALID;
+        }
+
+        unsigned char data[2 * MINI_CHUNK_HEADER_SIZE + 255 + sizeof(uint32_t)];
+        const size_t  n = min((size_t)dataSize, sizeof data);
+        if (file.readAt(pos + 2 * HEADER, data, n) != n)
+        {
+            return Animation::PROBE_INVALID;
+        }
+
+        string_view   name;
+        unsigned long index;
+        p = data;
+        if (!ProbeString(p, data + n, 4, &name) || !ProbeInteger(p, data + n, 5, &index))
+        {
+            return Animation::PROBE_INVALID;
+        }
+
+        if (!visit(name, (size_t)index))
+        {
+            return Animation::PROBE_INCOMPATIBLE;
+        }
+        pos += HEADER + boneSize;
+    }
+    return Animation::PROBE_COMPATIBLE;
+}
+
+// Same check as loading does, but most mismatches are found with a single lookup
+static bool BoneMatches(const Model& model, string_view name, size_t index)
+{
+    const size_t found = model.GetBone(name);
+    if (found == index)
+    {
+        return true;
+    }
+
+    // The lookup finds only the first of several bones with the same name
+    if (found == -1 || index >= model.GetNumBones())
+    {
+        return false;
+    }
+    const string& bone = model.GetBone(index).name;
+    return bone.length() == name.length() && _strnicmp(bone.c_str(), name.data(), name.length()) == 0;
+}
+
+Animation::ProbeResult Animation::Probe(const IFile& file, const Model& model)
+{
+    return ProbeBones(file, [&](string_view name, size_t index) {
+        return BoneMatches(model, name, index);
+    });
+}
+
+bool Animation::ReadBones(const IFile& file, vector<AnimatedBone>& bones)
+{
+    bones.clear();
+    const ProbeResult result = ProbeBones(file, [&](string_view name, size_t index) {
+        bones.push_back(AnimatedBone(string(name), index));
+        return true;
+    });
+
+    if (result != PROBE_COMPATIBLE)
+    {
+        bones.clear();
+        return false;
+    }
+    return true;
+}
+
+Animation::ProbeResult Animation::Probe(const vector<AnimatedBone>& bones, const Model& model)
+{
+    for (size_t i = 0; i < bones.size(); i++)
+    {
+        if (!BoneMatches(model, bones[i].first, bones[i].second))
+        {
+            return PROBE_INCOMPATIBLE;
+        }
+    }
+    return PROBE_COMPATIBLE;
+}
+
+}
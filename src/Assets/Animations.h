@@ -2,11 +2,26 @@
 #define ANIMATIONS_H
 
 #include "Assets/Models.h"
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace Alamo
 {
 
+// Quantized animation data, as stored in the file
+#pragma pack(1)
+struct PackedQuaternion
+{
+    int16_t x, y, z, w;
+};
+
+struct PackedVector
+{
+    uint16_t x, y, z;
+};
+#pragma pack()
+
 class Animation : public IObject
 {
     struct Frame
@@ -14,24 +29,65 @@ class Animation : public IObject
         Quaternion rotation;
         Vector3    translation;
         Vector3    scale;
-        bool       visible;
     };
 
-    float             m_fps;
-    unsigned long     m_nFrames;
-    Buffer<Frame>     m_frames;
+    struct BoneInfo
+    {
+        size_t         index;
+        Vector3        ofsTrans, scaleTrans;
+        Vector3        ofsScale, scaleScale;
+        unsigned short idxTrans, idxScale, idxRot;
+        Quaternion     defRotation;
+    };
 
-    struct BoneInfo;
-    struct AnimationData;
+    // The quantized tracks, interleaved per frame, as stored in the file
+    struct AnimationData
+    {
+        size_t                   transBlockSize, rotBlockSize, scaleBlockSize;
+        Buffer<PackedVector>     transData;
+        Buffer<PackedVector>     scaleData;
+        Buffer<PackedQuaternion> rotData;
+    };
 
-    void ReadBone(ChunkReader& reader, int version, const Model& model, BoneInfo& info, AnimationData& data, size_t dataOffset, bool checkOnly);
-    void ConstructTransforms(const Model& model, const std::vector<BoneInfo>& bones, const AnimationData& data);
+    // What a compressed animation keeps for every bone in the model
+    struct BoneTrack
+    {
+        BoneInfo   info;
+        bool       animated;      // Otherwise the bone keeps its rest transform
+        Vector3    restScale;
+        Quaternion restRotation;
+        Vector3    restTranslation;
+        size_t     parent;        // Parent bone, or -1 for root bones
+    };
+
+    float                 m_fps;
+    unsigned long         m_nFrames;
+    bool                  m_compressed;
+    Buffer<Frame>         m_frames;             // Absolute transforms, prebaked mode only
+    AnimationData         m_data;               // Compressed mode only
+    Buffer<BoneTrack>     m_tracks;             // Compressed mode only
+    Buffer<size_t>        m_order;              // Compressed mode only; the bones, parents first
+    Buffer<unsigned char> m_visibility;         // A bit per frame per bone
+    size_t                m_visibilityStride;
+
+    void ReadBone(ChunkReader& reader, int version, const Model& model, BoneInfo& info, size_t dataOffset, bool checkOnly);
+    void ConstructTransforms(const Model& model, const std::vector<BoneInfo>& bones);
+    void ConstructTracks(const Model& model, const std::vector<BoneInfo>& bones);
+    void   DecodeFrame(size_t bone, size_t frame, Vector3& scale, Quaternion& rotation, Vector3& translation) const;
+    Matrix GetRelativeFrame(size_t bone, size_t frame, float s) const;
+    bool   GetVisibility(size_t bone, size_t frame) const;
+    size_t GetFrameIndex(float t, float* s) const;
 
 public:
     float         GetFPS()       const { return m_fps; }
     unsigned long GetNumFrames() const { return m_nFrames; }
 
     Matrix GetFrame(size_t bone, float t) const;
+
+    /* Fills @pose with the transforms of all of the model's bones at time @t,
+     * as GetFrame() would return them, in a single pass over the skeleton.
+     */
+    void EvaluatePose(float t, Matrix* pose) const;
     bool  IsVisible(size_t bone, float t) const;
 
     // Returns the first time in [from,to] where the bone was (in)visible.
@@ -39,7 +95,37 @@ public:
     float GetVisibleEvent  (size_t bone, float from, float to) const;
     float GetInvisibleEvent(size_t bone, float from, float to) const;
 
-    Animation(ptr<IFile> file, const Model& model, bool checkOnly = false);
+    enum ProbeResult
+    {
+        PROBE_COMPATIBLE,       // The animation fits the model
+        PROBE_INCOMPATIBLE,     // The animation is for another model
+        PROBE_INVALID,          // The file is not an animation
+    };
+
+    // The name of an animated bone, and the index of the model bone it animates
+    typedef std::pair<std::string, size_t> AnimatedBone;
+
+    /* Checks if the animation in @file fits the model, without loading it.
+     * Only the bone names and indices at the start of the file are read, and
+     * reading stops at the first bone that does not fit, so the rest of the
+     * file is not validated. Does not throw, and does not move the file cursor.
+     */
+    static ProbeResult Probe(const IFile& file, const Model& model);
+
+    /* Reads the animated bones at the start of @file, as Probe() does, so they
+     * can be checked against several models. Returns false if the file is not
+     * an animation.
+     */
+    static bool        ReadBones(const IFile& file, std::vector<AnimatedBone>& bones);
+    static ProbeResult Probe(const std::vector<AnimatedBone>& bones, const Model& model);
+
+    /* Loads the animation for the model. By default, the absolute transform of
+     * every bone is prebaked for every frame, which makes GetFrame() cheap but
+     * takes about five times the memory of the file. A @compressed animation
+     * keeps the quantized tracks from the file instead, and decodes them and
+     * walks the bone's parents on every GetFrame().
+     */
+    Animation(ptr<IFile> file, const Model& model, bool checkOnly = false, bool compressed = false);
 };
 
 }
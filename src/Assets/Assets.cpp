@@ -1,10 +1,14 @@
 #include "Assets/Assets.h"
+#include "Assets/MegaFile.h"
 #include "General/Exceptions.h"
 #include "General/Utils.h"
 #include "General/XML.h"
 #include "General/ExactTypes.h"
 #include "General/Log.h"
+#include <exception>
 #include <map>
+#include <unordered_map>
+#include <shlobj.h>
 using namespace std;
 
 #ifndef NDEBUG
@@ -26,128 +30,534 @@ static const char*    ANIMATIONS_BASE_PATH      = "Data\\Art\\Models\\";
 static const char*    PARTICLESYSTEMS_BASE_PATH = "Data\\Art\\Models\\";
 static const char*    SHADERS_BASE_PATH         = "Data\\Art\\Shaders\\";
 static const char*    TEXTURES_BASE_PATH        = "Data\\Art\\Textures\\";
+static const char*    LOOSE_FILES_PATH          = "DATA\\";
 
-// MegaFile parsers
 #pragma pack(1)
-struct MEGHEADER
+// The index cache file starts with this header
+struct CACHEHEADER
 {
-	uint32_t nStrings;
-	uint32_t nFiles;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nMegaFiles;
 };
 
-// Represents a file in a MegaFile
-struct MEGFILEINFO
+// Followed by this for every cached MegaFile, followed by:
+// * wchar_t path[pathLength], padded to 4 bytes
+// * uint32_t fields[MegaFileTable::NUM_FIELDS][nFiles], sorted on CRC
+// * char names[namesSize], padded to 4 bytes
+struct CACHEENTRY
 {
-	uint32_t crc;
-	uint32_t index;
-	uint32_t size;
-	uint32_t start;
-	uint32_t nameIndex;
+    uint32_t entrySize;     // Total size of the entry, in bytes
+    uint32_t pathLength;
+    uint64_t fileSize;
+    uint64_t writeTime;
+    uint32_t nFiles;
+    uint32_t namesSize;
 };
 #pragma pack()
 
-typedef vector<MEGFILEINFO> FileIndex;
+static const wchar_t* INDEX_CACHE_FILENAME = L"MegaFiles.cache";
+static const uint32_t INDEX_CACHE_MAGIC    = 0x43494D41;    // "AMIC"
+static const uint32_t INDEX_CACHE_VERSION  = 2;
 
 struct MegaFileInfo
 {
-    wstring     m_filename; // For debugging purposes
-    string      m_basepath;
-	ptr<IFile>	m_file;
-    char*       m_data;
-    FileIndex   m_files;
+    wstring       m_filename;
+    string        m_basepath;
+    ptr<IFile>    m_file;         // The MegaFile itself, opened on first use
+    uint64_t      m_fileSize;
+    uint64_t      m_writeTime;
+    MegaFileTable m_table;        // Possibly attached to the index cache
 };
 
-typedef vector<MegaFileInfo> MegaFileIndex;
+// Entry in the merged file table of all MegaFiles
+struct FileSlot
+{
+    uint32_t hash;          // CRC of the full, uppercased, filename
+    uint32_t megaFile;      // Index in g_megaFiles, UINT32_MAX if the slot is empty
+    uint32_t file;          // Index in the MegaFile's file table
+};
+
+typedef vector<MegaFileInfo*> MegaFileIndex;
+typedef map<wstring, const CACHEENTRY*> CacheIndex;
+typedef unordered_map<string, size_t> LooseFileIndex;   // Uppercased filename -> basepath index
 
 static MegaFileIndex    g_megaFiles;
+static vector<FileSlot> g_fileTable;    // Open addressing, power-of-two size
 static vector<wstring>  g_basepaths;
+static LooseFileIndex   g_looseFiles;   // Snapshot of the physical files under LOOSE_FILES_PATH
+static vector<HANDLE>   g_looseWatch;   // Change notifications that invalidate the snapshot
+static ptr<IFile>       g_cache;        // Mapped index cache from the previous run
+static CacheIndex       g_cacheIndex;
+static bool             g_cacheDirty;
+
+template <typename T>
+static T Align4(T size)
+{
+    return (size + 3) & ~(T)3;
+}
 
-static void IndexMegaFile(const wstring& path, const string& basepath = "")
+static wstring GetCacheFilename()
 {
-#ifdef DEBUG_ASSETS
-    printf("Indexing %ls to \\%s\n", path.c_str(), basepath.c_str());
-#endif
+    wchar_t path[MAX_PATH];
+    if (SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA, NULL, 0, path) != S_OK)
+    {
+        return L"";
+    }
+    wstring dir = wstring(path) + L"\\AloViewer";
+    CreateDirectory(dir.c_str(), NULL);
+    return dir + L"\\" + INDEX_CACHE_FILENAME;
+}
+
+// Maps the index cache and validates its structure.
+// Entries are only trusted once their MegaFile's size and time match as well.
+static void LoadIndexCache()
+{
+    wstring filename = GetCacheFilename();
+    if (filename.empty())
+    {
+        return;
+    }
+
     try
     {
-        g_megaFiles.push_back(MegaFileInfo());
-        MegaFileInfo& megfile = g_megaFiles.back();
+        g_cache = new MappedFile(filename);
+        const char* data = (const char*)g_cache->data();
+        size_t      size = g_cache->size();
         
-        megfile.m_filename = path;
-        megfile.m_data     = NULL;
-        megfile.m_basepath = Uppercase(basepath);
+        const CACHEHEADER* header = (const CACHEHEADER*)data;
+        if (size < sizeof(CACHEHEADER) || header->magic != INDEX_CACHE_MAGIC || header->version != INDEX_CACHE_VERSION)
+        {
+            throw BadFileException();
+        }
 
-        try
+        size_t pos = sizeof(CACHEHEADER);
+        for (uint32_t i = 0; i < header->nMegaFiles; i++)
         {
-            megfile.m_file = new PhysicalFile(path);
-
-            // Add this megafile to the index
-	        MEGHEADER header;
-            if (megfile.m_file->read(&header, sizeof(header)) != sizeof(header))
-	        {
-		        throw ReadException();
-	        }
-
-	        //
-	        // Read filenames
-	        //
-    	    unsigned long nStrings = letohl(header.nStrings);
-	        vector<unsigned long> filenames(nStrings);
-	        unsigned long size = 0;
-	        for (unsigned long i = 0; i < nStrings; i++)
-	        {
-		        uint16_t leLength;
-		        if (megfile.m_file->read(&leLength, sizeof(uint16_t)) != sizeof(uint16_t))
-		        {
-			        throw ReadException();
-		        }
-                unsigned short length = letohs(leLength);
-                filenames[i] = size;
-                size += length + 1;
-
-                char* tmp = (char*)realloc(megfile.m_data, size);
-                if (tmp == NULL)
-                {
-                    throw bad_alloc();
-                }
-                megfile.m_data = tmp;
+            const CACHEENTRY* entry = (const CACHEENTRY*)(data + pos);
+            if (size - pos < sizeof(CACHEENTRY) || entry->entrySize > size - pos)
+            {
+                throw BadFileException();
+            }
 
-                if (megfile.m_file->read(&megfile.m_data[filenames[i]], length) != length)
+            // In 64 bits, so a corrupt entry can't wrap around on Win32
+            const uint64_t ofsFields = sizeof(CACHEENTRY) + Align4((uint64_t)entry->pathLength * sizeof(wchar_t));
+            const uint64_t ofsNames  = ofsFields + (uint64_t)entry->nFiles * MegaFileTable::NUM_FIELDS * sizeof(uint32_t);
+            if (ofsNames + entry->namesSize > entry->entrySize || (entry->namesSize > 0 && data[pos + (size_t)ofsNames + entry->namesSize - 1] != '\0'))
+            {
+                throw BadFileException();
+            }
+
+            const uint32_t* crcs  = (const uint32_t*)(data + pos + (size_t)ofsFields) + MegaFileTable::FIELD_CRC  * entry->nFiles;
+            const uint32_t* names = (const uint32_t*)(data + pos + (size_t)ofsFields) + MegaFileTable::FIELD_NAME * entry->nFiles;
+            for (uint32_t j = 0; j < entry->nFiles; j++)
+            {
+                if (names[j] >= entry->namesSize || (j > 0 && crcs[j - 1] > crcs[j]))
                 {
-                    throw ReadException();
+                    throw BadFileException();
                 }
-                megfile.m_data[size - 1] = '\0';
             }
 
-	        //
-	        // Read master index table
-	        //
-	        unsigned long nFiles = letohl(header.nFiles);
-            megfile.m_files.resize(nFiles);
-            if (megfile.m_file->read(&megfile.m_files[0], nFiles * sizeof(MEGFILEINFO)) != nFiles * sizeof(MEGFILEINFO))
-	        {
-		        throw ReadException();
-	        }
-
-            // Unpack
-	        for (unsigned long i = 0; i < nFiles; i++)
-	        {
-                MEGFILEINFO& fi = megfile.m_files[i];
-                fi.crc       = letohl(fi.crc);
-                fi.nameIndex = filenames[letohl(fi.nameIndex)];
-		        fi.start     = letohl(fi.start);
-		        fi.size      = letohl(fi.size);
-	        }
+            const wchar_t* path = (const wchar_t*)(data + pos + sizeof(CACHEENTRY));
+            g_cacheIndex[Uppercase(wstring(path, entry->pathLength))] = entry;
+            pos += entry->entrySize;
         }
-        catch (...)
+    }
+    catch (wexception&)
+    {
+        // No (usable) cache; it will be rebuilt
+        g_cacheIndex.clear();
+        g_cache = NULL;
+    }
+}
+
+static void AppendCacheEntry(Buffer<char>& out, const MegaFileInfo& megfile)
+{
+    const MegaFileTable& table = megfile.m_table;
+    const size_t fieldSize = table.GetNumFiles() * sizeof(uint32_t);
+
+    size_t ofsFields = sizeof(CACHEENTRY) + Align4(megfile.m_filename.length() * sizeof(wchar_t));
+    size_t ofsNames  = ofsFields + MegaFileTable::NUM_FIELDS * fieldSize;
+
+    CACHEENTRY entry;
+    entry.entrySize  = (uint32_t)(ofsNames + Align4(table.GetNamesSize()));
+    entry.pathLength = (uint32_t)megfile.m_filename.length();
+    entry.fileSize   = megfile.m_fileSize;
+    entry.writeTime  = megfile.m_writeTime;
+    entry.nFiles     = (uint32_t)table.GetNumFiles();
+    entry.namesSize  = (uint32_t)table.GetNamesSize();
+
+    size_t pos = out.size();
+    out.resize(pos + entry.entrySize);
+    memset(&out[pos], 0, entry.entrySize);
+    memcpy(&out[pos], &entry, sizeof(CACHEENTRY));
+    memcpy(&out[pos + sizeof(CACHEENTRY)], megfile.m_filename.c_str(), megfile.m_filename.length() * sizeof(wchar_t));
+    for (int f = 0; f < MegaFileTable::NUM_FIELDS; f++)
+    {
+        memcpy(&out[pos + ofsFields + f * fieldSize], table.GetField((MegaFileTable::Field)f), fieldSize);
+    }
+    memcpy(&out[pos + ofsNames], table.GetNames(), table.GetNamesSize());
+}
+
+// Writes the index of all MegaFiles to the cache. Entries from the previous
+// cache that weren't used this time (e.g., from another game) are kept.
+static void SaveIndexCache()
+{
+    wstring filename = GetCacheFilename();
+    if (filename.empty())
+    {
+        return;
+    }
+
+    Buffer<char> out(sizeof(CACHEHEADER));
+    CACHEHEADER header;
+    header.magic      = INDEX_CACHE_MAGIC;
+    header.version    = INDEX_CACHE_VERSION;
+    header.nMegaFiles = 0;
+
+    for (MegaFileIndex::const_iterator p = g_megaFiles.begin(); p != g_megaFiles.end(); p++)
+    {
+        const MegaFileInfo& megfile = **p;
+        AppendCacheEntry(out, megfile);
+        g_cacheIndex.erase(Uppercase(megfile.m_filename));
+        header.nMegaFiles++;
+    }
+
+    for (CacheIndex::const_iterator p = g_cacheIndex.begin(); p != g_cacheIndex.end(); p++)
+    {
+        out.append((const char*)p->second, p->second->entrySize);
+        header.nMegaFiles++;
+    }
+    memcpy(&out[0], &header, sizeof(CACHEHEADER));
+
+    // The MegaFiles can't keep pointing into the old cache once we overwrite it
+    for (MegaFileIndex::iterator p = g_megaFiles.begin(); p != g_megaFiles.end(); p++)
+    {
+        (*p)->m_table.Detach();
+    }
+    g_cacheIndex.clear();
+    g_cache = NULL;
+
+    try
+    {
+        ptr<IFile> file = new PhysicalFile(filename, FM_WRITE);
+        file->write(out, out.size());
+    }
+    catch (IOException&)
+    {
+        // Not being able to cache is not a problem
+    }
+}
+
+// A MegaFile to be indexed during initialization
+struct IndexJob
+{
+    wstring       path;
+    string        basepath;
+    MegaFileInfo* megfile;      // The result, or NULL if the MegaFile could not be indexed
+    bool          reindexed;    // Was the MegaFile itself read, rather than the cache?
+};
+
+// Shared by the indexing threads; jobs are handed out in order
+struct IndexQueue
+{
+    vector<IndexJob>& jobs;
+    volatile LONG     next;
+    volatile LONG     failed;
+    exception_ptr     error;    // The first unexpected error; rethrown once the threads are done
+};
+
+static const size_t MAX_INDEX_THREADS = 16;
+
+// Indexes a single MegaFile. Only reads shared state, so jobs can run concurrently.
+static void IndexMegaFile(IndexJob& job)
+{
+#ifdef DEBUG_ASSETS
+    printf("Indexing %ls to \\%s\n", job.path.c_str(), job.basepath.c_str());
+#endif
+    job.megfile   = NULL;
+    job.reindexed = false;
+
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (!GetFileAttributesEx(job.path.c_str(), GetFileExInfoStandard, &attr))
+    {
+        // Doesn't exist (or is inaccessible), skip it
+        return;
+    }
+
+    MegaFileInfo* megfile = new MegaFileInfo;
+    try
+    {
+        megfile->m_filename  = job.path;
+        megfile->m_basepath  = Uppercase(job.basepath);
+        megfile->m_fileSize  = ((uint64_t)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+        megfile->m_writeTime = ((uint64_t)attr.ftLastWriteTime.dwHighDateTime << 32) | attr.ftLastWriteTime.dwLowDateTime;
+
+        CacheIndex::const_iterator p = g_cacheIndex.find(Uppercase(job.path));
+        if (p != g_cacheIndex.end() && p->second->fileSize == megfile->m_fileSize && p->second->writeTime == megfile->m_writeTime)
+        {
+            // Use the cached index, straight from the mapping
+            const CACHEENTRY* entry  = p->second;
+            const uint32_t*   fields = (const uint32_t*)((const char*)entry + sizeof(CACHEENTRY) + Align4(entry->pathLength * sizeof(wchar_t)));
+            const uint32_t*   table[MegaFileTable::NUM_FIELDS];
+            for (int f = 0; f < MegaFileTable::NUM_FIELDS; f++)
+            {
+                table[f] = fields + f * entry->nFiles;
+            }
+            megfile->m_table.Attach(table, entry->nFiles, (const char*)(fields + MegaFileTable::NUM_FIELDS * entry->nFiles), entry->namesSize);
+        }
+        else
         {
-            delete[] megfile.m_data;
-            g_megaFiles.resize(g_megaFiles.size() - 1);
-            throw;
+            megfile->m_file = OpenMappedFile(megfile->m_filename);
+            megfile->m_table.Read(megfile->m_file);
+            job.reindexed = true;
         }
     }
     catch (IOException&)
     {
+        delete megfile;
+        return;
+    }
+    catch (BadFileException&)
+    {
+        delete megfile;
+        return;
+    }
+    catch (bad_alloc&)
+    {
+        // Corrupt counts in the header
+        delete megfile;
+        return;
     }
+    catch (...)
+    {
+        delete megfile;
+        throw;
+    }
+    job.megfile = megfile;
+}
+
+static DWORD WINAPI IndexThreadFunc(LPVOID lpParam)
+{
+    IndexQueue& queue = *(IndexQueue*)lpParam;
+    LONG i;
+    while (queue.failed == 0 && (i = InterlockedIncrement(&queue.next) - 1) < (LONG)queue.jobs.size())
+    {
+        try
+        {
+            IndexMegaFile(queue.jobs[i]);
+        }
+        catch (...)
+        {
+            // Only the first error is kept
+            if (InterlockedExchange(&queue.failed, 1) == 0)
+            {
+                queue.error = current_exception();
+            }
+        }
+    }
+    return 0;
+}
+
+// Indexes all MegaFiles concurrently, so their I/O latencies overlap.
+// The results are left in the jobs, in their original order.
+static void IndexMegaFiles(vector<IndexJob>& jobs)
+{
+    IndexQueue queue = {jobs, 0, 0};
+
+    // Indexing is mostly waiting on the disk, so use more threads than processors
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    size_t nThreads = min(min((size_t)si.dwNumberOfProcessors * 2, MAX_INDEX_THREADS), jobs.size());
+
+    vector<HANDLE> hThreads;
+    for (size_t i = 1; i < nThreads; i++)
+    {
+        DWORD  ThreadID;
+        HANDLE hThread = CreateThread(NULL, 0, IndexThreadFunc, &queue, 0, &ThreadID);
+        if (hThread == NULL)
+        {
+            // Carry on with the threads we have
+            break;
+        }
+        hThreads.push_back(hThread);
+    }
+
+    // This thread helps out as well
+    IndexThreadFunc(&queue);
+
+    if (!hThreads.empty())
+    {
+        WaitForMultipleObjects((DWORD)hThreads.size(), &hThreads[0], TRUE, INFINITE);
+        for (size_t i = 0; i < hThreads.size(); i++)
+        {
+            CloseHandle(hThreads[i]);
+        }
+    }
+
+    if (queue.failed != 0)
+    {
+        // Drop what was indexed, so nothing is half-initialized
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            delete jobs[i].megfile;
+            jobs[i].megfile = NULL;
+        }
+        rethrow_exception(queue.error);
+    }
+}
+
+// Checks if the slot in the file table refers to the specified full filename
+static bool IsFileSlot(const FileSlot& slot, const char* name)
+{
+    const MegaFileInfo& megfile = *g_megaFiles[slot.megaFile];
+    return strncmp(name, megfile.m_basepath.c_str(), megfile.m_basepath.length()) == 0
+        && strcmp(megfile.m_table.GetFilename(slot.file), name + megfile.m_basepath.length()) == 0;
+}
+
+// Constructs the merged file table for all indexed MegaFiles
+static void BuildFileTable()
+{
+    size_t nFiles = 0;
+    for (MegaFileIndex::const_iterator p = g_megaFiles.begin(); p != g_megaFiles.end(); p++)
+    {
+        nFiles += (*p)->m_table.GetNumFiles();
+    }
+
+    // Keep the load factor at or below one half
+    size_t size = 16;
+    while (size < 2 * nFiles)
+    {
+        size *= 2;
+    }
+    const FileSlot empty = {0, UINT32_MAX, 0};
+    g_fileTable.assign(size, empty);
+
+    // Insert MegaFiles in order, so later ones override earlier ones
+    string name;
+    for (size_t i = 0; i < g_megaFiles.size(); i++)
+    {
+        const MegaFileTable& table    = g_megaFiles[i]->m_table;
+        const string&        basepath = g_megaFiles[i]->m_basepath;
+        for (size_t j = 0; j < table.GetNumFiles(); j++)
+        {
+            uint32_t hash = table.GetCRC(j);
+            if (!basepath.empty())
+            {
+                name = basepath + table.GetFilename(j);
+                hash = crc32(name.c_str(), name.length());
+            }
+            else
+            {
+                name = table.GetFilename(j);
+            }
+
+            size_t k = hash & (size - 1);
+            while (g_fileTable[k].megaFile != UINT32_MAX && (g_fileTable[k].hash != hash || !IsFileSlot(g_fileTable[k], name.c_str())))
+            {
+                k = (k + 1) & (size - 1);
+            }
+
+            FileSlot& slot = g_fileTable[k];
+            if (slot.megaFile == UINT32_MAX || slot.megaFile != i)
+            {
+                // New file, or override from an earlier MegaFile
+                slot.hash     = hash;
+                slot.megaFile = (uint32_t)i;
+                slot.file     = (uint32_t)j;
+            }
+        }
+    }
+}
+
+// Adds all files in the directory, recursively, to the loose file snapshot
+static void SnapshotDirectory(const wstring& path, const string& name, size_t basepath)
+{
+    WIN32_FIND_DATA wfd;
+    HANDLE hFind = FindFirstFile((path + L"*").c_str(), &wfd);
+    if (hFind != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (wcscmp(wfd.cFileName, L".") == 0 || wcscmp(wfd.cFileName, L"..") == 0)
+            {
+                continue;
+            }
+
+            string filename = WideToAnsi(wfd.cFileName);
+            transform(filename.begin(), filename.end(), filename.begin(), ::toupper);
+            if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                SnapshotDirectory(path + wfd.cFileName + L"\\", name + filename + "\\", basepath);
+            }
+            else
+            {
+                // Earlier basepaths take precedence, so don't overwrite
+                g_looseFiles.insert(make_pair(name + filename, basepath));
+            }
+        } while (FindNextFile(hFind, &wfd));
+        FindClose(hFind);
+    }
+}
+
+static void CloseLooseFileWatch()
+{
+    for (size_t i = 0; i < g_looseWatch.size(); i++)
+    {
+        FindCloseChangeNotification(g_looseWatch[i]);
+    }
+    g_looseWatch.clear();
+}
+
+// Returns true if files may have been added to or removed from the snapshotted directories
+static bool LooseFilesChanged()
+{
+    bool changed = false;
+    for (size_t i = 0; i < g_looseWatch.size(); i++)
+    {
+        if (WaitForSingleObject(g_looseWatch[i], 0) == WAIT_OBJECT_0)
+        {
+            FindNextChangeNotification(g_looseWatch[i]);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void RefreshLooseFiles()
+{
+    CloseLooseFileWatch();
+    g_looseFiles.clear();
+    for (size_t i = 0; i < g_basepaths.size(); i++)
+    {
+        // Watch the directory before scanning it, so no change goes unnoticed. Without
+        // a loose files directory, watch the base path for it to be created.
+        const wstring path  = g_basepaths[i] + AnsiToWide(LOOSE_FILES_PATH);
+        HANDLE        watch = FindFirstChangeNotification(path.c_str(), TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME);
+        if (watch == INVALID_HANDLE_VALUE)
+        {
+            watch = FindFirstChangeNotification(g_basepaths[i].c_str(), FALSE, FILE_NOTIFY_CHANGE_DIR_NAME);
+        }
+        if (watch != INVALID_HANDLE_VALUE)
+        {
+            g_looseWatch.push_back(watch);
+        }
+
+        SnapshotDirectory(path, LOOSE_FILES_PATH, i);
+    }
+#ifdef DEBUG_ASSETS
+    printf("Loose files: %u\n", (unsigned int)g_looseFiles.size());
+#endif
+}
+
+static void AddIndexJob(vector<IndexJob>& jobs, const wstring& path, const string& basepath = "")
+{
+    IndexJob job;
+    job.path      = path;
+    job.basepath  = basepath;
+    job.megfile   = NULL;
+    job.reindexed = false;
+    jobs.push_back(job);
 }
 
 // Initialize the asset manager
@@ -157,7 +567,11 @@ void Initialize(const vector<wstring>& basepaths)
     // First clean up the current state
     Uninitialize();
 
+    LoadIndexCache();
+    g_cacheDirty = false;
+
     g_basepaths = basepaths;
+    vector<IndexJob> jobs;
     for (vector<wstring>::reverse_iterator path = g_basepaths.rbegin(); path != g_basepaths.rend(); path++)
     {
         // Ensure a trailing backslash on the paths
@@ -180,7 +594,7 @@ void Initialize(const vector<wstring>& basepaths)
             for (size_t i = 0; i < root->getNumChildren(); i++)
             {
                 const XMLNode* child = root->getChild(i);
-                IndexMegaFile(*path + child->getData());
+                AddIndexJob(jobs, *path + child->getData());
             }
         }
         // Could not find or parse master index file, carry on
@@ -188,13 +602,32 @@ void Initialize(const vector<wstring>& basepaths)
         catch (ParseException&) {}
 
         // Add the sound files
-        IndexMegaFile(*path + SFX2D_LOCALIZED,     "DATA\\AUDIO\\SFX\\");
-        IndexMegaFile(*path + SFX2D_NON_LOCALIZED, "DATA\\AUDIO\\SFX\\");
-        IndexMegaFile(*path + SFX3D_NON_LOCALIZED, "DATA\\AUDIO\\SFX\\");
+        AddIndexJob(jobs, *path + SFX2D_LOCALIZED,     "DATA\\AUDIO\\SFX\\");
+        AddIndexJob(jobs, *path + SFX2D_NON_LOCALIZED, "DATA\\AUDIO\\SFX\\");
+        AddIndexJob(jobs, *path + SFX3D_NON_LOCALIZED, "DATA\\AUDIO\\SFX\\");
 
         // Add the patch mega-file last
-        IndexMegaFile(*path + PATCH_MEGAFILE);
+        AddIndexJob(jobs, *path + PATCH_MEGAFILE);
+    }
+
+    // Index all MegaFiles, then add them in the original order so later ones still win
+    IndexMegaFiles(jobs);
+    for (vector<IndexJob>::const_iterator job = jobs.begin(); job != jobs.end(); job++)
+    {
+        if (job->megfile != NULL)
+        {
+            g_megaFiles.push_back(job->megfile);
+            g_cacheDirty |= job->reindexed;
+        }
+    }
+
+    if (g_cacheDirty)
+    {
+        // Something was (re)indexed, update the cache for the next time
+        SaveIndexCache();
     }
+    BuildFileTable();
+    RefreshLooseFiles();
 }
 
 // Clear the master file index
@@ -202,49 +635,47 @@ void Uninitialize()
 {
     for (MegaFileIndex::const_iterator p = g_megaFiles.begin(); p != g_megaFiles.end(); p++)
     {
-        delete[] p->m_data;
+        delete *p;
     }
     g_megaFiles.clear();
+    g_fileTable.clear();
     g_basepaths.clear();
+    g_looseFiles.clear();
+    CloseLooseFileWatch();
+    g_cacheIndex.clear();
+    g_cache = NULL;
 }
 
-static ptr<IFile> LoadSpecificFile(const MegaFileInfo& megfile, const string& filename)
+// Looks up the uppercased full filename in the merged file table
+static ptr<IFile> LoadMegaFileFile(const string& filename)
 {
-    // The base of the path must match this MegaFile's base path
-    const char* name = filename.c_str();
-    if (strncmp(name, megfile.m_basepath.c_str(), megfile.m_basepath.length()) == 0)
+    if (g_fileTable.empty())
     {
-        name = name + megfile.m_basepath.length();
-        unsigned long crc = crc32(name, filename.length() - megfile.m_basepath.length());
-        
-        int low = 0, high = (int)megfile.m_files.size() - 1;
-        while (high >= low)
+        return NULL;
+    }
+
+    const size_t mask = g_fileTable.size() - 1;
+    uint32_t     hash = crc32(filename.c_str(), filename.length());
+    for (size_t k = hash & mask; g_fileTable[k].megaFile != UINT32_MAX; k = (k + 1) & mask)
+    {
+        const FileSlot& slot = g_fileTable[k];
+        if (slot.hash == hash && IsFileSlot(slot, filename.c_str()))
         {
-            int mid = (low + high) / 2;
-            if (crc == megfile.m_files[mid].crc)
-            {
-                const MEGFILEINFO* fi = &megfile.m_files[mid];
-                while (mid > 0 && (fi - 1)->crc == crc) { mid--; fi--; }
-                while (mid != megfile.m_files.size() && fi->crc == crc)
-                {
-                    if (strcmp(megfile.m_data + fi->nameIndex, name) == 0)
-                    {
-                        // Found it
+            // Found it
+            MegaFileInfo& megfile = *g_megaFiles[slot.megaFile];
+            const char*   name    = megfile.m_table.GetFilename(slot.file);
 #ifdef DEBUG_ASSETS
-                        printf("Loaded file: %ls:%s\n", megfile.m_filename.c_str(), name);
+            printf("Loaded file: %ls:%s\n", megfile.m_filename.c_str(), name);
 #endif
-                        return new SubFile(megfile.m_file, name, fi->start, fi->size);
-                    }
-                    fi++;
-                    mid++;
-                }
-                break;
+            if (megfile.m_file == NULL)
+            {
+                // Indexed from the cache, open it now
+                megfile.m_file = OpenMappedFile(megfile.m_filename);
             }
-            if (crc < megfile.m_files[mid].crc) high = mid - 1;
-            else                                low  = mid + 1;
+            return new SubFile(megfile.m_file, name, megfile.m_table.GetStart(slot.file), megfile.m_table.GetSize(slot.file));
         }
     }
-    // File not found in this MegaFile
+    // File not found in any MegaFile
     return NULL;
 }
 
@@ -287,8 +718,35 @@ static ptr<IFile> LoadSpecificFile(string filename, const char* prefix)
         filename[ofs] = '\\';
     }
 
+    string upper = filename;
+    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
     // Search physical locations first
-    for (vector<wstring>::const_iterator i = g_basepaths.begin(); i != g_basepaths.end(); i++)
+    if (upper.compare(0, strlen(LOOSE_FILES_PATH), LOOSE_FILES_PATH) == 0)
+    {
+        // Covered by the snapshot, so a miss doesn't have to touch the disk
+        if (LooseFilesChanged())
+        {
+            RefreshLooseFiles();
+        }
+        LooseFileIndex::const_iterator p = g_looseFiles.find(upper);
+        if (p != g_looseFiles.end())
+        {
+            try
+            {
+                ptr<IFile> file = new PhysicalFile(g_basepaths[p->second] + AnsiToWide(filename));
+#ifdef DEBUG_ASSETS
+                printf("Loaded file: %ls%s\n", g_basepaths[p->second].c_str(), filename.c_str());
+#endif
+                return file;
+            }
+            catch (FileNotFoundException&)
+            {
+                // Deleted since the snapshot was taken
+            }
+        }
+    }
+    else for (vector<wstring>::const_iterator i = g_basepaths.begin(); i != g_basepaths.end(); i++)
     {
         try
         {
@@ -305,16 +763,7 @@ static ptr<IFile> LoadSpecificFile(string filename, const char* prefix)
     }
     
     // File does not exist physically, check master file index
-    transform(filename.begin(), filename.end(), filename.begin(), ::toupper);
-    for (MegaFileIndex::const_reverse_iterator p = g_megaFiles.rbegin(); p != g_megaFiles.rend(); p++)
-    {
-        ptr<IFile> file = LoadSpecificFile(*p, filename);
-        if (file != NULL)
-        {
-            return file;
-        }
-    }
-    return NULL;
+    return LoadMegaFileFile(upper);
 }
 
 ptr<IFile> LoadFile(const string& filename, const char* prefix, const char* const* extensions)
@@ -28,6 +28,13 @@ namespace Assets
      */
     void Initialize(const std::vector<std::wstring> &basepaths);
 
+    /* Rescans the base paths for physical files. The manager takes a snapshot of
+     * all files under Data/ during initialization and only opens physical files
+     * found in it. It watches those directories and rescans by itself when they
+     * change, so this is only needed where change notifications don't work.
+     */
+    void RefreshLooseFiles();
+
     /* Frees up all resources. Call this at program termination. */
     void Uninitialize();
 
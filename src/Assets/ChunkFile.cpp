@@ -19,6 +19,9 @@ struct MINICHUNKHDR
 };
 #pragma pack()
 
+static_assert(sizeof(CHUNKHDR)     == CHUNK_HEADER_SIZE,      "CHUNKHDR does not match CHUNK_HEADER_SIZE");
+static_assert(sizeof(MINICHUNKHDR) == MINI_CHUNK_HEADER_SIZE, "MINICHUNKHDR does not match MINI_CHUNK_HEADER_SIZE");
+
 ChunkType ChunkReader::nextMini()
 {
 	assert(m_curDepth >= 0);
@@ -195,6 +198,22 @@ unsigned long ChunkReader::readInteger()
 	return letohl(value);
 }
 
+void ChunkReader::ToHostOrder(uint16_t* values, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        values[i] = letohs(values[i]);
+    }
+}
+
+void ChunkReader::ToHostOrder(uint32_t* values, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        values[i] = letohl(values[i]);
+    }
+}
+
 size_t ChunkReader::read(void* buffer, size_t size, bool check)
 {
 	if (m_size >= 0)
@@ -211,7 +230,7 @@ size_t ChunkReader::read(void* buffer, size_t size, bool check)
 }
 
 ChunkReader::ChunkReader(ptr<IFile> file)
-    : m_file(file)
+    : m_file(MakeBuffered(file))
 {
 	m_offsets[0] = (unsigned long)m_file->size();
 	m_curDepth   = 0;
@@ -219,36 +238,213 @@ ChunkReader::ChunkReader(ptr<IFile> file)
 	m_miniSize   = -1;
 }
 
+long ChunkIndex::Find(ChunkType type, long parent, long after) const
+{
+    long i = after;
+    if (i != -1)
+    {
+        i = m_chunks[i].next;
+    }
+    else if (parent == -1)
+    {
+        i = m_chunks.empty() ? -1 : 0;
+    }
+    else
+    {
+        // The first child, if any, directly follows its parent
+        i = (parent + 1 < (long)m_chunks.size() && m_chunks[parent + 1].parent == parent) ? parent + 1 : -1;
+    }
+
+    for (; i != -1; i = m_chunks[i].next)
+    {
+        if (m_chunks[i].type == type)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const void* ChunkIndex::GetData(size_t index) const
+{
+    const char* data = (const char*)m_file->data();
+    return (data != NULL) ? data + m_chunks[index].offset : NULL;
+}
+
+ptr<IFile> ChunkIndex::GetFile(size_t index) const
+{
+    const Chunk& chunk = m_chunks[index];
+    return new SubFile(m_file, "", chunk.offset - sizeof(CHUNKHDR), chunk.size + sizeof(CHUNKHDR));
+}
+
+ChunkIndex::ChunkIndex(ptr<IFile> file)
+    : m_file(file)
+{
+    // Chunks that are still open, and the last chunk seen at every depth
+    vector<long> groups;
+    vector<long> last(1, -1);
+
+    const unsigned long fileSize = (unsigned long)m_file->size();
+    unsigned long pos = 0;
+    for (;;)
+    {
+        // Close the groups that end here
+        while (!groups.empty() && pos == m_chunks[groups.back()].offset + m_chunks[groups.back()].size)
+        {
+            groups.pop_back();
+        }
+
+        const unsigned long end = groups.empty() ? fileSize : m_chunks[groups.back()].offset + m_chunks[groups.back()].size;
+        if (pos == end)
+        {
+            // End of file
+            break;
+        }
+
+        CHUNKHDR hdr;
+        if (end - pos < sizeof(CHUNKHDR) || m_file->readAt(pos, &hdr, sizeof(CHUNKHDR)) != sizeof(CHUNKHDR))
+        {
+            throw BadFileException();
+        }
+
+        Chunk chunk;
+        chunk.type   = letohl(hdr.type);
+        chunk.offset = pos + sizeof(CHUNKHDR);
+        chunk.size   = letohl(hdr.size) & 0x7FFFFFFF;
+        chunk.group  = (letohl(hdr.size) & 0x80000000) != 0;
+        chunk.depth  = (int)groups.size();
+        chunk.parent = groups.empty() ? -1 : groups.back();
+        chunk.next   = -1;
+        if (chunk.size > end - chunk.offset)
+        {
+            throw BadFileException();
+        }
+
+        // Link it to its previous sibling
+        long index = (long)m_chunks.size();
+        if (last[chunk.depth] != -1)
+        {
+            m_chunks[last[chunk.depth]].next = index;
+        }
+        last[chunk.depth] = index;
+        m_chunks.push_back(chunk);
+
+        if (chunk.group)
+        {
+            // Descend into it
+            if (chunk.depth + 1 >= MAX_CHUNK_DEPTH)
+            {
+                throw BadFileException();
+            }
+            groups.push_back(index);
+            last.resize(chunk.depth + 2);
+            last[chunk.depth + 1] = -1;
+            pos = chunk.offset;
+        }
+        else
+        {
+            pos = chunk.offset + chunk.size;
+        }
+    }
+}
+
+void ChunkWriter::append(const void* buffer, size_t size)
+{
+	// Grow the staging buffer geometrically
+	size_t pos = m_data.size();
+	if (pos + size > m_data.capacity())
+	{
+		m_data.reserve(max(pos + size, 2 * m_data.capacity()));
+	}
+	m_data.resize(pos + size);
+	memcpy(&m_data[pos], buffer, size);
+
+	if (m_mode == CWM_STREAMING && m_data.size() >= STREAM_BLOCK_SIZE)
+	{
+		flush();
+	}
+}
+
 void ChunkWriter::beginChunk(ChunkType type)
 {
-	m_curDepth++;
-	m_chunks[m_curDepth].offset   = m_file->tell();
-	m_chunks[m_curDepth].hdr.type = type;
-	m_chunks[m_curDepth].hdr.size = 0;
-	if (m_curDepth > 0)
+	assert(m_mode == CWM_STAGED);
+	assert(m_miniChunk.offset == -1);
+	assert(m_curDepth + 1 < MAX_CHUNK_DEPTH);
+
+	if (m_curDepth >= 0)
 	{
 		// Set 'container' bit in parent chunk
-		m_chunks[m_curDepth-1].hdr.size |= 0x80000000;
+		m_chunks[m_curDepth].group = true;
 	}
 
-	// Write dummy header
-	CHUNKHDR hdr = {0,0};
-	m_file->write(&hdr, sizeof(CHUNKHDR));
+	ChunkInfo& chunk = m_chunks[++m_curDepth];
+	chunk.type   = type;
+	chunk.offset = tell();
+	chunk.end    = -1;
+	chunk.group  = false;
+
+	// Write dummy header, endChunk() fills it in
+	CHUNKHDR hdr = {0, 0};
+	append(&hdr, sizeof(CHUNKHDR));
 }
 
 void ChunkWriter::beginMiniChunk(ChunkType type)
 {
-	assert(m_curDepth >= 0);
+	assert(m_mode == CWM_STAGED);
+	assert(m_curDepth >= 0 && !m_chunks[m_curDepth].group);
 	assert(m_miniChunk.offset == -1);
 	assert(type <= 0xFF);
 
-	m_miniChunk.offset   = m_file->tell();
-	m_miniChunk.hdr.type = (uint8_t)type;
-	m_miniChunk.hdr.size = 0;
+	m_miniChunk.type   = type;
+	m_miniChunk.offset = tell();
+	m_miniChunk.end    = -1;
 	
-	// Write dummy header
+	// Write dummy header, endChunk() fills it in
 	MINICHUNKHDR hdr = {0, 0};
-	m_file->write(&hdr, sizeof(MINICHUNKHDR));
+	append(&hdr, sizeof(MINICHUNKHDR));
+}
+
+void ChunkWriter::beginChunk(ChunkType type, unsigned long size, bool group)
+{
+	assert(m_mode == CWM_STREAMING);
+	assert(m_miniChunk.offset == -1);
+	assert(m_curDepth + 1 < MAX_CHUNK_DEPTH);
+	// The header is written right away, so a size that doesn't fit would
+	// silently corrupt the file
+	if (size > 0x7FFFFFFF || (m_curDepth >= 0 && (!m_chunks[m_curDepth].group ||
+	    (uint64_t)tell() + sizeof(CHUNKHDR) + size > m_chunks[m_curDepth].end)))
+	{
+		throw WriteException();
+	}
+
+	ChunkInfo& chunk = m_chunks[++m_curDepth];
+	chunk.type   = type;
+	chunk.offset = tell();
+	chunk.end    = chunk.offset + sizeof(CHUNKHDR) + size;
+	chunk.group  = group;
+
+	CHUNKHDR hdr = { htolel(type), htolel(size | (group ? 0x80000000 : 0)) };
+	append(&hdr, sizeof(CHUNKHDR));
+}
+
+void ChunkWriter::beginMiniChunk(ChunkType type, unsigned char size)
+{
+	assert(m_mode == CWM_STREAMING);
+	assert(m_curDepth >= 0 && !m_chunks[m_curDepth].group);
+	assert(m_miniChunk.offset == -1);
+	assert(type <= 0xFF);
+
+	if ((uint64_t)tell() + sizeof(MINICHUNKHDR) + size > m_chunks[m_curDepth].end)
+	{
+		throw WriteException();
+	}
+
+	m_miniChunk.type   = type;
+	m_miniChunk.offset = tell();
+	m_miniChunk.end    = m_miniChunk.offset + sizeof(MINICHUNKHDR) + size;
+
+	MINICHUNKHDR hdr = { (uint8_t)type, size };
+	append(&hdr, sizeof(MINICHUNKHDR));
 }
 
 void ChunkWriter::endChunk()
@@ -257,30 +453,44 @@ void ChunkWriter::endChunk()
 	if (m_miniChunk.offset != -1)
 	{
 		// Ending mini-chunk
-		long pos  = m_file->tell();
-		long size = pos - (m_miniChunk.offset + sizeof(MINICHUNKHDR));
-		assert(size <= 0xFF);
-
-		m_miniChunk.hdr.size = (uint8_t)size;
-		
-		MINICHUNKHDR hdr = {m_miniChunk.hdr.type, m_miniChunk.hdr.size};
-		m_file->seek(m_miniChunk.offset);
-		m_file->write(&hdr, sizeof(MINICHUNKHDR) );
-		m_file->seek(pos);
+		if (m_mode == CWM_STAGED)
+		{
+			unsigned long size = tell() - (m_miniChunk.offset + sizeof(MINICHUNKHDR));
+			assert(size <= 0xFF);
+
+			MINICHUNKHDR hdr = { (uint8_t)m_miniChunk.type, (uint8_t)size };
+			memcpy(&m_data[m_miniChunk.offset - m_flushed], &hdr, sizeof(MINICHUNKHDR));
+		}
+		else
+		{
+			// The size was promised in beginMiniChunk()
+			if (tell() != m_miniChunk.end)
+			{
+				throw WriteException();
+			}
+		}
 		m_miniChunk.offset = -1;
 	}
 	else
 	{
 		// Ending normal chunk
-		long pos  = m_file->tell();
-		long size = pos - (m_chunks[m_curDepth].offset + sizeof(CHUNKHDR));
-
-		CHUNKHDR hdr = { htolel(m_chunks[m_curDepth].hdr.type), htolel(m_chunks[m_curDepth].hdr.size) };
-		m_chunks[m_curDepth].hdr.size = (m_chunks[m_curDepth].hdr.size & 0x80000000) | (size & ~0x80000000);
-		m_file->seek(m_chunks[m_curDepth].offset);
-		m_file->write(&hdr, sizeof(CHUNKHDR));
-		m_file->seek(pos);
+		const ChunkInfo& chunk = m_chunks[m_curDepth];
+		if (m_mode == CWM_STAGED)
+		{
+			unsigned long size = tell() - (chunk.offset + sizeof(CHUNKHDR));
+			assert(size <= 0x7FFFFFFF);
 
+			CHUNKHDR hdr = { htolel(chunk.type), htolel(size | (chunk.group ? 0x80000000 : 0)) };
+			memcpy(&m_data[chunk.offset - m_flushed], &hdr, sizeof(CHUNKHDR));
+		}
+		else
+		{
+			// The size was promised in beginChunk()
+			if (tell() != chunk.end)
+			{
+				throw WriteException();
+			}
+		}
 		m_curDepth--;
 	}
 }
@@ -288,10 +498,12 @@ void ChunkWriter::endChunk()
 void ChunkWriter::write(const void* buffer, size_t size)
 {
 	assert(m_curDepth >= 0);
-	if (m_file->write(buffer, size) != size)
+	if (m_mode == CWM_STREAMING && (uint64_t)tell() + size > (m_miniChunk.offset != -1 ? m_miniChunk.end : m_chunks[m_curDepth].end))
 	{
+		// More than was promised for the chunk
 		throw WriteException();
 	}
+	append(buffer, size);
 }
 
 void ChunkWriter::writeString(const std::string& str)
@@ -299,9 +511,26 @@ void ChunkWriter::writeString(const std::string& str)
 	write(str.c_str(), (int)str.length() + 1);
 }
 
-ChunkWriter::ChunkWriter(ptr<IFile> file)
-    : m_file(file)
+void ChunkWriter::flush()
+{
+	// Staged chunk headers can still change until the chunk has ended
+	assert(m_mode == CWM_STREAMING || m_curDepth < 0);
+
+	if (!m_data.empty())
+	{
+		if (m_file->write(m_data, m_data.size()) != m_data.size())
+		{
+			throw WriteException();
+		}
+		m_flushed += (unsigned long)m_data.size();
+		m_data.resize(0);
+	}
+}
+
+ChunkWriter::ChunkWriter(ptr<IFile> file, Mode mode)
+    : m_file(file), m_mode(mode)
 {
+	m_flushed  = 0;
 	m_curDepth = -1;
 	m_miniChunk.offset = -1;
 }
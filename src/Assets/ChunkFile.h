@@ -3,8 +3,10 @@
 
 #include "Assets/Files.h"
 #include "General/3DTypes.h"
+#include "General/ExactTypes.h"
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace Alamo
 {
@@ -23,6 +25,11 @@ struct MiniChunkHeader
 	unsigned char size;
 };
 
+// Sizes of the chunk headers in the file, for code that reads chunks straight
+// from the file or computes chunk sizes for streaming
+static const unsigned long CHUNK_HEADER_SIZE      = 8;
+static const unsigned long MINI_CHUNK_HEADER_SIZE = 2;
+
 class ChunkReader
 {
 	static const int MAX_CHUNK_DEPTH = 256;
@@ -35,6 +42,9 @@ class ChunkReader
 	long        m_miniOffset;
 	int         m_curDepth;
 
+    static void ToHostOrder(uint16_t* values, size_t count);
+    static void ToHostOrder(uint32_t* values, size_t count);
+
 public:
 	ChunkType   next();
 	ChunkType   nextMini();
@@ -42,6 +52,8 @@ public:
 	size_t      size();
 	size_t      read(void* buffer, size_t size, bool check = true);
     size_t      tell() { return m_position; }
+    // Returns the position of the read cursor in the file itself
+    unsigned long offset() const { return m_file->tell(); }
     bool        group() const { return m_size < 0; }
 
 	float			readFloat();
@@ -55,55 +67,183 @@ public:
     Color           readColorRGB();
     Color           readColorRGBA();
 
+    /* Reads @count little-endian values of @T at once, which must be an 8, 16
+     * or 32-bit integer or float type. Throws a ReadException if the chunk
+     * does not hold enough data.
+     */
+    template <typename T>
+    void readArray(T* values, size_t count)
+    {
+        read(values, count * sizeof(T));
+#ifndef LITTLE_ENDIAN
+        switch (sizeof(T))
+        {
+            case sizeof(uint16_t): ToHostOrder((uint16_t*)values, count); break;
+            case sizeof(uint32_t): ToHostOrder((uint32_t*)values, count); break;
+        }
+#endif
+    }
+
 	ChunkReader(ptr<IFile> file);
 };
 
 //
 // TemplateReader is a class to allow for the reading
 // of values from ChunkReaders by templates.
+// All values consist of NUM_FLOATS floats, so arrays of them can be read
+// with ChunkReader::readArray() and converted with unpack().
 //
 template <typename T> 
 struct TemplateReader {
     static T read(ChunkReader& reader);
 };
-template <> struct TemplateReader<float>   { static float   read(ChunkReader& reader) { return reader.readFloat();     } };
-template <> struct TemplateReader<Color>   { static Color   read(ChunkReader& reader) { return reader.readColorRGBA(); } };
-template <> struct TemplateReader<Vector3> { static Vector3 read(ChunkReader& reader) { return reader.readVector3();   } };
-template <> struct TemplateReader<Vector4> { static Vector4 read(ChunkReader& reader) { return reader.readVector4();   } };
+template <> struct TemplateReader<float>   { enum { NUM_FLOATS = 1 }; static float   read(ChunkReader& reader) { return reader.readFloat();     } static float   unpack(const float* f) { return f[0]; } };
+template <> struct TemplateReader<Color>   { enum { NUM_FLOATS = 4 }; static Color   read(ChunkReader& reader) { return reader.readColorRGBA(); } static Color   unpack(const float* f) { return Color(f[0], f[1], f[2], f[3]); } };
+template <> struct TemplateReader<Vector3> { enum { NUM_FLOATS = 3 }; static Vector3 read(ChunkReader& reader) { return reader.readVector3();   } static Vector3 unpack(const float* f) { return Vector3(f[0], f[1], f[2]); } };
+template <> struct TemplateReader<Vector4> { enum { NUM_FLOATS = 4 }; static Vector4 read(ChunkReader& reader) { return reader.readVector4();   } static Vector4 unpack(const float* f) { return Vector4(f); } };
 
 template <typename T1, typename T2> 
 struct TemplateReader< std::pair<T1,T2> > {
+    enum { NUM_FLOATS = TemplateReader<T1>::NUM_FLOATS + TemplateReader<T2>::NUM_FLOATS };
     static std::pair<T1,T2> read(ChunkReader& reader) {
         const T1 t1 = TemplateReader<T1>::read(reader);
         const T2 t2 = TemplateReader<T2>::read(reader);
         return std::make_pair(t1,t2);
     }
+    static std::pair<T1,T2> unpack(const float* f) {
+        return std::make_pair(TemplateReader<T1>::unpack(f), TemplateReader<T2>::unpack(f + TemplateReader<T1>::NUM_FLOATS));
+    }
 };
 
-class ChunkWriter
+/* Index of all chunks in a chunk file, built in a single pass over the chunk
+ * headers without reading any chunk data. Use this to jump straight to the
+ * chunks you need. Mini-chunks are not indexed, since they cannot be told
+ * apart from data by the header of their chunk; read those with a
+ * ChunkReader on the chunk's file (see GetFile()).
+ * Throws a BadFileException if the chunk structure is invalid.
+ */
+class ChunkIndex
 {
+public:
+    struct Chunk
+    {
+        ChunkType     type;
+        unsigned long offset;   // Offset of the chunk's data in the file
+        unsigned long size;     // Size of the chunk's data
+        bool          group;    // Does the chunk contain other chunks?
+        int           depth;    // 0 for top-level chunks
+        long          parent;   // Index of the parent chunk, or -1 for top-level chunks
+        long          next;     // Index of the next chunk with the same parent, or -1
+    };
+
+    size_t       GetNumChunks() const              { return m_chunks.size(); }
+    const Chunk& GetChunk(size_t index) const      { return m_chunks[index]; }
+    ptr<IFile>   GetFile() const                   { return m_file; }
+
+    /* Returns the index of the first chunk of the given type with the given
+     * parent, or -1 if there is no such chunk.
+     *  @type:   type of the chunk to find.
+     *  @parent: index of the parent chunk, or -1 to find a top-level chunk.
+     *  @after:  index of a chunk with the same parent to continue after, or
+     *           -1 to start at the first chunk.
+     */
+    long Find(ChunkType type, long parent = -1, long after = -1) const;
+
+    /* Returns a pointer to the data of the chunk, straight from the file, or
+     * NULL if the file is not memory-resident.
+     */
+    const void* GetData(size_t index) const;
+
+    /* Returns the data of the chunk as an array of @T, straight from the file,
+     * or NULL if the file is not memory-resident.
+     *  @count: receives the number of elements in the array.
+     */
+    template <typename T>
+    const T* GetArray(size_t index, size_t* count) const
+    {
+        *count = m_chunks[index].size / sizeof(T);
+        return (const T*)GetData(index);
+    }
+
+    /* Returns a file with just the chunk, header included. The first next()
+     * on a ChunkReader for this file returns the chunk itself.
+     */
+    ptr<IFile> GetFile(size_t index) const;
+
+    ChunkIndex(ptr<IFile> file);
+
+private:
 	static const int MAX_CHUNK_DEPTH = 256;
-	
-	template <typename HdrType>
-	struct ChunkInfo
-	{
-		HdrType       hdr;
-		unsigned long offset;
-	};
 
-	IFile*                     m_file;
-	ChunkInfo<ChunkHeader>     m_chunks[ MAX_CHUNK_DEPTH ];
-	ChunkInfo<MiniChunkHeader> m_miniChunk;
-	int                        m_curDepth;
+    ptr<IFile>         m_file;
+    std::vector<Chunk> m_chunks;
+};
 
+/* Writes chunk files without ever seeking in the output file, so it can be
+ * a pipe as well. There are two modes:
+ * - CWM_STAGED:    the whole file is built in memory and written with a single
+ *                  write by flush(). Chunk sizes are filled in by endChunk().
+ * - CWM_STREAMING: the size of every chunk is passed to beginChunk(), so its
+ *                  header can be written right away. Data is written to the
+ *                  file in large blocks as it comes in. A chunk that does not
+ *                  fit in its parent, or whose data does not add up to the
+ *                  promised size, throws a WriteException.
+ * In both modes, call flush() after the last chunk has been ended.
+ */
+class ChunkWriter
+{
 public:
+    enum Mode
+    {
+        CWM_STAGED,
+        CWM_STREAMING,
+    };
+
+    // Begins a chunk in staged mode
 	void beginChunk(ChunkType type);
 	void beginMiniChunk(ChunkType type);
+
+    /* Begins a chunk in streaming mode.
+     *  @size:  size of the chunk's data, including the headers of any chunks in it.
+     *  @group: does the chunk contain other chunks?
+     */
+	void beginChunk(ChunkType type, unsigned long size, bool group);
+	void beginMiniChunk(ChunkType type, unsigned char size);
+
 	void endChunk();
 	void write(const void* buffer, size_t size);
 	void writeString(const std::string& str);
 
-	ChunkWriter(ptr<IFile> file);
+    /* Writes all pending data to the file.
+     * In staged mode, this can only be done in between top-level chunks.
+     * If the file could not be written, a WriteException is thrown.
+     */
+    void flush();
+
+	ChunkWriter(ptr<IFile> file, Mode mode = CWM_STAGED);
+
+private:
+	static const int    MAX_CHUNK_DEPTH   = 256;
+	static const size_t STREAM_BLOCK_SIZE = 64 * 1024;
+
+	struct ChunkInfo
+	{
+		ChunkType     type;
+		unsigned long offset;   // Position of the chunk's header
+		unsigned long end;      // Position of the end of the chunk, when streaming
+		bool          group;
+	};
+
+	ptr<IFile>    m_file;
+	Mode          m_mode;
+	Buffer<char>  m_data;       // Data that has not been written to the file yet
+	unsigned long m_flushed;    // Amount of data that has been written to the file
+	ChunkInfo     m_chunks[ MAX_CHUNK_DEPTH ];
+	ChunkInfo     m_miniChunk;
+	int           m_curDepth;
+
+	unsigned long tell() const { return m_flushed + (unsigned long)m_data.size(); }
+	void append(const void* buffer, size_t size);
 };
 
 }
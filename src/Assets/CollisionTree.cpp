@@ -0,0 +1,289 @@
+#include "Assets/CollisionTree.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+using namespace std;
+
+namespace Alamo
+{
+
+// Leaves hold at most this many triangles
+static const size_t MAX_LEAF_SIZE = 4;
+
+// Deep enough for any tree built by median splits
+static const int MAX_STACK_DEPTH = 64;
+
+static void Grow(BoundingBox& box, const Vector3& v)
+{
+    box.min.x = min(box.min.x, v.x); box.max.x = max(box.max.x, v.x);
+    box.min.y = min(box.min.y, v.y); box.max.y = max(box.max.y, v.y);
+    box.min.z = min(box.min.z, v.z); box.max.z = max(box.max.z, v.z);
+}
+
+static bool BoxesOverlap(const BoundingBox& a, const BoundingBox& b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x
+        && a.min.y <= b.max.y && b.min.y <= a.max.y
+        && a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+// Returns the distance at which the ray enters the box, or FLT_MAX if it misses
+static float IntersectBox(const BoundingBox& box, const Vector3& origin, const Vector3& invDir, float maxDistance)
+{
+    float tmin = 0.0f, tmax = maxDistance;
+    const float* bmin = box.min, *bmax = box.max, *o = origin, *inv = invDir;
+    for (int i = 0; i < 3; i++)
+    {
+        float t1 = (bmin[i] - o[i]) * inv[i];
+        float t2 = (bmax[i] - o[i]) * inv[i];
+        tmin = max(tmin, min(t1, t2));
+        tmax = min(tmax, max(t1, t2));
+    }
+    return (tmin <= tmax) ? tmin : FLT_MAX;
+}
+
+// Moller-Trumbore; returns the distance along the ray, or FLT_MAX if it misses
+static float IntersectTriangle(const Vector3* v, const Vector3& origin, const Vector3& direction)
+{
+    const Vector3 e1 = v[1] - v[0];
+    const Vector3 e2 = v[2] - v[0];
+    const Vector3 p  = direction.cross(e2);
+    const float  det = e1.dot(p);
+    if (fabs(det) < 1e-12f)
+    {
+        // Ray is parallel to the triangle
+        return FLT_MAX;
+    }
+
+    const float   inv = 1.0f / det;
+    const Vector3 s   = origin - v[0];
+    const float   u   = s.dot(p) * inv;
+    if (u < 0.0f || u > 1.0f)
+    {
+        return FLT_MAX;
+    }
+
+    const Vector3 q = s.cross(e1);
+    const float   w = direction.dot(q) * inv;
+    if (w < 0.0f || u + w > 1.0f)
+    {
+        return FLT_MAX;
+    }
+    return e2.dot(q) * inv;
+}
+
+// Separating axis test of a triangle against a box
+static bool TriangleOverlapsBox(const Vector3* v, const BoundingBox& box)
+{
+    const Vector3 center = (box.min + box.max) * 0.5f;
+    const Vector3 extent = (box.max - box.min) * 0.5f;
+    const Vector3 p[3]   = {v[0] - center, v[1] - center, v[2] - center};
+    const Vector3 e[3]   = {p[1] - p[0], p[2] - p[1], p[0] - p[2]};
+
+    // The box's axes, the triangle's normal and the cross products of their edges
+    Vector3 axes[13] = {
+        Vector3(1,0,0), Vector3(0,1,0), Vector3(0,0,1),
+        e[0].cross(e[1]),
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            axes[4 + i * 3 + j] = axes[i].cross(e[j]);
+        }
+    }
+
+    for (int i = 0; i < 13; i++)
+    {
+        const Vector3& a = axes[i];
+        float d0 = a.dot(p[0]), d1 = a.dot(p[1]), d2 = a.dot(p[2]);
+        float r  = extent.x * fabs(a.x) + extent.y * fabs(a.y) + extent.z * fabs(a.z);
+        if (min(d0, min(d1, d2)) > r || max(d0, max(d1, d2)) < -r)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CollisionTree::AddTriangle(const Triangle& triangle, const Vector3& v1, const Vector3& v2, const Vector3& v3)
+{
+    Entry entry;
+    entry.triangle = triangle;
+    entry.v[0] = v1;
+    entry.v[1] = v2;
+    entry.v[2] = v3;
+    m_triangles.push_back(entry);
+}
+
+void CollisionTree::Build()
+{
+    m_nodes.clear();
+    if (m_triangles.empty())
+    {
+        // A leaf without triangles would look like an inner node, so leave
+        // the tree empty; the queries miss on an empty tree.
+        return;
+    }
+    m_nodes.reserve(2 * m_triangles.size() / MAX_LEAF_SIZE + 1);
+    BuildNode(0, m_triangles.size());
+}
+
+// Builds the subtree over the triangles and returns the index of its root.
+// Inner nodes split at the median along the longest axis of the centroids.
+uint32_t CollisionTree::BuildNode(size_t first, size_t count)
+{
+    uint32_t index = (uint32_t)m_nodes.size();
+    m_nodes.push_back(Node());
+
+    BoundingBox bounds    = {Vector3( FLT_MAX,  FLT_MAX,  FLT_MAX), Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX)};
+    BoundingBox centroids = bounds;
+    for (size_t i = first; i < first + count; i++)
+    {
+        const Entry& t = m_triangles[i];
+        Grow(bounds, t.v[0]);
+        Grow(bounds, t.v[1]);
+        Grow(bounds, t.v[2]);
+        Grow(centroids, t.v[0] + t.v[1] + t.v[2]);
+    }
+    m_nodes[index].bounds = bounds;
+
+    if (count <= MAX_LEAF_SIZE)
+    {
+        m_nodes[index].first = (uint32_t)first;
+        m_nodes[index].count = (uint32_t)count;
+        return index;
+    }
+
+    const Vector3 size = centroids.max - centroids.min;
+    const int     axis = (size.x >= size.y && size.x >= size.z) ? 0 : (size.y >= size.z) ? 1 : 2;
+    const size_t  half = count / 2;
+    nth_element(m_triangles.begin() + first, m_triangles.begin() + first + half, m_triangles.begin() + first + count,
+        [axis](const Entry& a, const Entry& b) {
+            return ((const float*)(a.v[0] + a.v[1] + a.v[2]))[axis] < ((const float*)(b.v[0] + b.v[1] + b.v[2]))[axis];
+        });
+
+    BuildNode(first, half);
+    uint32_t right = BuildNode(first + half, count - half);
+    m_nodes[index].first = right;
+    m_nodes[index].count = 0;
+    return index;
+}
+
+bool CollisionTree::IntersectRay(const Vector3& origin, const Vector3& direction, float maxDistance, Hit* hit) const
+{
+    if (m_nodes.empty())
+    {
+        return false;
+    }
+
+    const Vector3 invDir(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+    float         nearest = maxDistance;
+    const Entry*  found   = NULL;
+    uint32_t      stack[MAX_STACK_DEPTH];
+    int           depth   = 0;
+    stack[depth++] = 0;
+    while (depth > 0)
+    {
+        const Node& node = m_nodes[stack[--depth]];
+        if (IntersectBox(node.bounds, origin, invDir, nearest) == FLT_MAX)
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                float t = IntersectTriangle(m_triangles[i].v, origin, direction);
+                if (t >= 0.0f && t <= nearest && t != FLT_MAX)
+                {
+                    nearest = t;
+                    found   = &m_triangles[i];
+                }
+            }
+        }
+        else
+        {
+            // Visit the nearer child first, so that more of the other one gets
+            // culled. The stack pops in reverse, so push the farther one first.
+            uint32_t child1 = (uint32_t)(&node - &m_nodes[0]) + 1;
+            uint32_t child2 = node.first;
+            float    t1     = IntersectBox(m_nodes[child1].bounds, origin, invDir, nearest);
+            float    t2     = IntersectBox(m_nodes[child2].bounds, origin, invDir, nearest);
+            if (t1 < t2) {
+                swap(child1, child2);
+                swap(t1, t2);
+            }
+            if (t1 != FLT_MAX) stack[depth++] = child1;
+            if (t2 != FLT_MAX) stack[depth++] = child2;
+        }
+    }
+
+    if (found == NULL)
+    {
+        return false;
+    }
+
+    if (hit != NULL)
+    {
+        hit->triangle = found->triangle;
+        hit->distance = nearest;
+    }
+    return true;
+}
+
+// Calls @visitor for every triangle that intersects the box, until it returns false
+template <typename Visitor>
+bool CollisionTree::VisitBox(const BoundingBox& box, Visitor& visitor) const
+{
+    if (m_nodes.empty())
+    {
+        return true;
+    }
+
+    uint32_t stack[MAX_STACK_DEPTH];
+    int      depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0)
+    {
+        uint32_t    index = stack[--depth];
+        const Node& node  = m_nodes[index];
+        if (!BoxesOverlap(node.bounds, box))
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                if (TriangleOverlapsBox(m_triangles[i].v, box) && !visitor(m_triangles[i].triangle))
+                {
+                    return false;
+                }
+            }
+        }
+        else
+        {
+            stack[depth++] = node.first;
+            stack[depth++] = index + 1;
+        }
+    }
+    return true;
+}
+
+void CollisionTree::FindTriangles(const BoundingBox& box, vector<Triangle>& triangles) const
+{
+    auto collect = [&triangles](const Triangle& t) { triangles.push_back(t); return true; };
+    VisitBox(box, collect);
+}
+
+bool CollisionTree::Overlaps(const BoundingBox& box) const
+{
+    auto stop = [](const Triangle&) { return false; };
+    return !VisitBox(box, stop);
+}
+
+}
@@ -0,0 +1,78 @@
+#ifndef COLLISIONTREE_H
+#define COLLISIONTREE_H
+
+#include "General/GameTypes.h"
+#include "General/Objects.h"
+#include "General/ExactTypes.h"
+#include <vector>
+
+namespace Alamo
+{
+
+/*
+ * Bounding volume hierarchy over the triangles of a mesh, for ray casts and
+ * box queries in O(log n) instead of testing every triangle.
+ */
+class CollisionTree : public IObject
+{
+public:
+    // Identifies a triangle in the mesh
+    struct Triangle
+    {
+        uint32_t subMesh;
+        uint32_t face;      // Index of the first of the face's indices, divided by three
+    };
+
+    // The nearest triangle along a ray
+    struct Hit
+    {
+        Triangle triangle;
+        float    distance;  // In units of the ray's direction
+    };
+
+    /* Adds a triangle to the tree. Call Build() after adding all triangles. */
+    void AddTriangle(const Triangle& triangle, const Vector3& v1, const Vector3& v2, const Vector3& v3);
+
+    /* Builds the hierarchy over the added triangles. */
+    void Build();
+
+    /* Finds the nearest triangle hit by the ray @origin + t * @direction,
+     * with 0 <= t <= @maxDistance. Triangles are hit from both sides.
+     * Returns false if no triangle is hit.
+     */
+    bool IntersectRay(const Vector3& origin, const Vector3& direction, float maxDistance, Hit* hit) const;
+
+    /* Appends all triangles that intersect the box to @triangles. */
+    void FindTriangles(const BoundingBox& box, std::vector<Triangle>& triangles) const;
+
+    /* Returns true if any triangle intersects the box. */
+    bool Overlaps(const BoundingBox& box) const;
+
+    size_t GetNumTriangles() const { return m_triangles.size(); }
+
+private:
+    struct Node
+    {
+        BoundingBox bounds;
+        uint32_t    first;  // First triangle for leaves, right child for inner nodes
+        uint32_t    count;  // Number of triangles for leaves, 0 for inner nodes; the left child follows the node
+    };
+
+    struct Entry
+    {
+        Triangle triangle;
+        Vector3  v[3];
+    };
+
+    uint32_t BuildNode(size_t first, size_t count);
+
+    template <typename Visitor>
+    bool VisitBox(const BoundingBox& box, Visitor& visitor) const;
+
+    std::vector<Entry> m_triangles;
+    std::vector<Node>  m_nodes;
+};
+
+}
+
+#endif
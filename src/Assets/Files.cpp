@@ -43,13 +43,28 @@ unsigned long PhysicalFile::skip(long count)
 
 size_t PhysicalFile::read(void* buffer, size_t size)
 {
+	size_t read = readAt(m_offset, buffer, size);
+	m_offset += (unsigned long)read;
+	return read;
+}
+
+size_t PhysicalFile::readAt(unsigned long offset, void* buffer, size_t size) const
+{
+	// Passing the position in the OVERLAPPED structure makes the read
+	// independent of the handle's file pointer.
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(OVERLAPPED));
+	overlapped.Offset = offset;
+
 	DWORD read;
-	SetFilePointer(m_hFile, m_offset, NULL, FILE_BEGIN);
-	if (!ReadFile(m_hFile, buffer, (DWORD)size, &read, NULL))
+	if (!ReadFile(m_hFile, buffer, (DWORD)size, &read, &overlapped))
 	{
+		if (GetLastError() == ERROR_HANDLE_EOF)
+		{
+			return 0;
+		}
 		throw ReadException();
 	}
-	m_offset += read;
 	return read;
 }
 
@@ -65,10 +80,17 @@ size_t PhysicalFile::write(const void* buffer, size_t size)
 	return written;
 }
 
-PhysicalFile::PhysicalFile(const wstring& filename)
+PhysicalFile::PhysicalFile(const wstring& filename, FileMode mode)
     : IFile(filename)
 {
-	m_hFile = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mode == FM_WRITE)
+	{
+		m_hFile = CreateFile(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	}
+	else
+	{
+		m_hFile = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	}
 	if (m_hFile == INVALID_HANDLE_VALUE)
 	{
 		DWORD error = GetLastError();
@@ -86,6 +108,112 @@ PhysicalFile::~PhysicalFile()
 	CloseHandle(m_hFile);
 }
 
+/*
+ * MappedFile class
+ */
+bool MappedFile::eof() const
+{
+	return tell() == size();
+}
+
+size_t MappedFile::size() const
+{
+	return m_size;
+}
+
+unsigned long MappedFile::tell() const
+{
+	return m_offset;
+}
+
+unsigned long MappedFile::seek(unsigned long pos)
+{
+	return m_offset = pos;
+}
+
+unsigned long MappedFile::skip(long count)
+{
+	return m_offset = min(max(m_offset + count, 0), (unsigned long)size() - 1);
+}
+
+size_t MappedFile::read(void* buffer, size_t size)
+{
+	size_t read = readAt(m_offset, buffer, size);
+	m_offset += (unsigned long)read;
+	return read;
+}
+
+size_t MappedFile::readAt(unsigned long offset, void* buffer, size_t size) const
+{
+	if (offset >= m_size)
+	{
+		return 0;
+	}
+	size = min(size, m_size - offset);
+	memcpy(buffer, m_data + offset, size);
+	return size;
+}
+
+size_t MappedFile::write(const void* buffer, size_t size)
+{
+	// Mappings are read-only
+	throw WriteException();
+}
+
+const void* MappedFile::data() const
+{
+	return m_data;
+}
+
+MappedFile::MappedFile(const wstring& filename)
+    : IFile(filename)
+{
+	m_hFile = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		DWORD error = GetLastError();
+		if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND)
+		{
+			throw FileNotFoundException(filename);
+		}
+		throw IOException(L"Unable to open file:\n" + filename);
+	}
+
+	m_size     = GetFileSize(m_hFile, NULL);
+	m_offset   = 0;
+	m_hMapping = NULL;
+	m_data     = NULL;
+	if (m_size > 0)
+	{
+		// Empty files cannot be mapped, they simply have no data
+		m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_hMapping != NULL)
+		{
+			m_data = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+		}
+
+		if (m_data == NULL)
+		{
+			if (m_hMapping != NULL)
+			{
+				CloseHandle(m_hMapping);
+			}
+			CloseHandle(m_hFile);
+			throw IOException(L"Unable to map file:\n" + filename);
+		}
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data != NULL)
+	{
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_hMapping);
+	}
+	CloseHandle(m_hFile);
+}
+
 /*
  * SubFile class
  */
@@ -116,13 +244,21 @@ unsigned long SubFile::skip(long count)
 
 size_t SubFile::read(void* buffer, size_t size)
 {
-	m_file->seek(m_start + m_offset);
-    size = min(size, m_size - m_offset);
-	size_t read = m_file->read(buffer, size);
+	size_t read = readAt(m_offset, buffer, size);
 	m_offset += (unsigned long)read;
 	return read;
 }
 
+size_t SubFile::readAt(unsigned long offset, void* buffer, size_t size) const
+{
+	if (offset >= m_size)
+	{
+		return 0;
+	}
+	size = min(size, m_size - offset);
+	return m_file->readAt(m_start + offset, buffer, size);
+}
+
 size_t SubFile::write(const void* buffer, size_t size)
 {
 	m_file->seek(m_start + m_offset);
@@ -131,6 +267,14 @@ size_t SubFile::write(const void* buffer, size_t size)
 	return written;
 }
 
+const void* SubFile::data() const
+{
+	// Don't hand out a pointer that runs past the end of the parent
+	const char*  data = (const char*)m_file->data();
+	const size_t size = m_file->size();
+	return (data != NULL && m_start <= size && m_size <= size - m_start) ? data + m_start : NULL;
+}
+
 SubFile::SubFile(IFile* file, const std::string& subfilename, unsigned long start, unsigned long size)
     : IFile(file->name() + L"|" + AnsiToWide(subfilename))
 {
@@ -145,3 +289,181 @@ SubFile::~SubFile()
 {
 	SAFE_RELEASE(m_file);
 }
+
+/*
+ * BufferedFile class
+ */
+bool BufferedFile::eof() const
+{
+	return tell() == size();
+}
+
+size_t BufferedFile::size() const
+{
+	return m_size;
+}
+
+unsigned long BufferedFile::tell() const
+{
+	return m_offset;
+}
+
+unsigned long BufferedFile::seek(unsigned long pos)
+{
+	return m_offset = pos;
+}
+
+unsigned long BufferedFile::skip(long count)
+{
+	return m_offset = min(max(m_offset + count, 0), (unsigned long)size() - 1);
+}
+
+const BufferedFile::Block& BufferedFile::GetBlock(unsigned long offset)
+{
+	// See if we have the block already and otherwise find the least recently used one
+	Block* lru = &m_blocks[0];
+	for (size_t i = 0; i < m_blocks.size(); i++)
+	{
+		Block& block = m_blocks[i];
+		if (block.offset == offset)
+		{
+			block.lastUse = ++m_time;
+			return block;
+		}
+
+		if (block.lastUse < lru->lastUse)
+		{
+			lru = &block;
+		}
+	}
+
+	// Replace it
+	lru->offset  = -1;
+	lru->data.resize(m_blockSize);
+	lru->size    = m_file->readAt(offset, lru->data, m_blockSize);
+	lru->offset  = offset;
+	lru->lastUse = ++m_time;
+	return *lru;
+}
+
+size_t BufferedFile::read(void* buffer, size_t size)
+{
+	if (m_offset >= m_size)
+	{
+		return 0;
+	}
+
+	if (size >= m_blockSize)
+	{
+		// Large read, caching this would gain us nothing
+		size_t read = m_file->readAt(m_offset, buffer, size);
+		m_offset += (unsigned long)read;
+		return read;
+	}
+
+	// Copy from the cached blocks; a small read spans at most two blocks
+	char*  dest = (char*)buffer;
+	size_t read = 0;
+	while (read < size && m_offset < m_size)
+	{
+		unsigned long start = m_offset - m_offset % m_blockSize;
+		const Block&  block = GetBlock(start);
+		size_t        ofs   = m_offset - start;
+		if (ofs >= block.size)
+		{
+			break;
+		}
+
+		size_t n = min(size - read, block.size - ofs);
+		memcpy(dest + read, block.data + ofs, n);
+		read     += n;
+		m_offset += (unsigned long)n;
+	}
+	return read;
+}
+
+size_t BufferedFile::readAt(unsigned long offset, void* buffer, size_t size) const
+{
+	// Go straight to the underlying file; the cache is only for read()
+	return m_file->readAt(offset, buffer, size);
+}
+
+size_t BufferedFile::write(const void* buffer, size_t size)
+{
+	// Drop all cached blocks that overlap the written range
+	for (size_t i = 0; i < m_blocks.size(); i++)
+	{
+		Block& block = m_blocks[i];
+		if (block.offset != -1 && block.offset < m_offset + size && m_offset < block.offset + m_blockSize)
+		{
+			block.offset  = -1;
+			block.lastUse = 0;
+		}
+	}
+
+	m_file->seek(m_offset);
+	size_t written = m_file->write(buffer, size);
+	m_offset += (unsigned long)written;
+	m_size    = max(m_size, (size_t)m_offset);
+	return written;
+}
+
+const void* BufferedFile::data() const
+{
+	return m_file->data();
+}
+
+BufferedFile::BufferedFile(IFile* file, size_t blockSize, size_t numBlocks)
+    : IFile(file->name())
+{
+	assert(blockSize > 0 && numBlocks > 0);
+
+	m_file      = file;
+	m_blockSize = blockSize;
+	m_size      = file->size();
+	m_offset    = file->tell();
+	m_time      = 0;
+	m_blocks.resize(numBlocks);
+	for (size_t i = 0; i < numBlocks; i++)
+	{
+		m_blocks[i].offset  = -1;
+		m_blocks[i].size    = 0;
+		m_blocks[i].lastUse = 0;
+	}
+	m_file->AddRef();
+}
+
+BufferedFile::~BufferedFile()
+{
+	SAFE_RELEASE(m_file);
+}
+
+/*
+ * Helper functions
+ */
+ptr<IFile> Alamo::MakeBuffered(ptr<IFile> file)
+{
+	if (file->data() != NULL)
+	{
+		// Already in memory, buffering would only add copies
+		return file;
+	}
+	return new BufferedFile(file);
+}
+
+ptr<IFile> Alamo::OpenMappedFile(const wstring& filename)
+{
+	try
+	{
+		return new MappedFile(filename);
+	}
+	catch (FileNotFoundException&)
+	{
+		throw;
+	}
+	catch (IOException&)
+	{
+		// Fall back to regular reads
+	}
+	return new PhysicalFile(filename);
+}
@@ -3,6 +3,7 @@
 
 #include "General/Objects.h"
 #include <string>
+#include <vector>
 
 namespace Alamo
 {
@@ -47,6 +48,19 @@ public:
      */
 	virtual size_t read(void* buffer, size_t size) = 0;
 
+    /* Reads data from the file at the specified position. The file cursor is
+     * neither used nor changed, so unlike read(), this can be called on the same
+     * file from several threads at once. Note that the reference counts of file
+     * objects are not thread-safe, so create and release them on one thread.
+     * Returns the number of bytes read. This may differ from @size if an attempt
+     * to read past EOF was made.
+     * If the file could not be read, a ReadException is thrown.
+     *  @offset: position, in bytes, relative to the start of the file.
+     *  @buffer: address in memory to write data to.
+     *  @size:   number of bytes to read from the file.
+     */
+	virtual size_t readAt(unsigned long offset, void* buffer, size_t size) const = 0;
+
     /* Writes data to the file at the current file cursor.
      * Returns the number of bytes written.
      * If the file could not be written, a WriteException is thrown.
@@ -55,10 +69,24 @@ public:
      */
     virtual size_t write(const void* buffer, size_t size) = 0;
 
+    /* Returns a pointer to the entire contents of the file if the file is
+     * resident in memory (e.g., memory-mapped), or NULL if it is not.
+     * The pointer remains valid for as long as the file object exists.
+     * Use size() for the length of the data.
+     */
+    virtual const void* data() const { return NULL; }
+
     IFile(const std::wstring& name);
     virtual ~IFile() {}
 };
 
+// Modes in which a PhysicalFile can be opened
+enum FileMode
+{
+    FM_READ,    // Open an existing file for reading
+    FM_WRITE,   // Create or truncate a file for reading and writing
+};
+
 /* IFile implementation for physical files, i.e. files directly visible
  * in the OS' file system */
 class PhysicalFile : public IFile
@@ -75,17 +103,55 @@ public:
 	unsigned long seek(unsigned long pos);
 	unsigned long skip(long count);
 	size_t read(void* buffer, size_t size);
+	size_t readAt(unsigned long offset, void* buffer, size_t size) const;
 	size_t write(const void* buffer, size_t size);
 
     /* Constructs the file for the given filename.
      * If the file cannot be found, a FileNotFoundException will be thrown.
      * If the file cannot be opened, an IOException will be thrown.
      *  @filename: path of the file.
+     *  @mode:     how to open the file.
      */
-    PhysicalFile(const std::wstring& filename);
+    PhysicalFile(const std::wstring& filename, FileMode mode = FM_READ);
 };
 
-/* IFile implementation for files-in-files, i.e. files embedded in other files. */
+/* IFile implementation for physical files that are mapped into memory as a
+ * whole. Reads do not cause any system calls and data() exposes the mapping.
+ * The file is read-only.
+ */
+class MappedFile : public IFile
+{
+	void*         m_hFile;
+	void*         m_hMapping;
+	const char*   m_data;
+	size_t        m_size;
+	unsigned long m_offset;
+
+	~MappedFile();
+public:
+    // Functions inherited from IFile
+	bool eof() const;
+	size_t size() const;
+	unsigned long tell() const;
+	unsigned long seek(unsigned long pos);
+	unsigned long skip(long count);
+	size_t read(void* buffer, size_t size);
+	size_t readAt(unsigned long offset, void* buffer, size_t size) const;
+	size_t write(const void* buffer, size_t size);
+	const void* data() const;
+
+    /* Constructs and maps the file for the given filename.
+     * If the file cannot be found, a FileNotFoundException will be thrown.
+     * If the file cannot be opened or mapped, an IOException will be thrown.
+     *  @filename: path of the file.
+     */
+    MappedFile(const std::wstring& filename);
+};
+
+/* IFile implementation for files-in-files, i.e. files embedded in other files.
+ * Reads go through the parent's readAt(), so SubFiles of the same parent
+ * do not share a file cursor.
+ */
 class SubFile : public IFile
 {
 	IFile*        m_file;
@@ -102,7 +168,9 @@ public:
 	unsigned long seek(unsigned long pos);
 	unsigned long skip(long count);
 	size_t read(void* buffer, size_t size);
+	size_t readAt(unsigned long offset, void* buffer, size_t size) const;
 	size_t write(const void* buffer, size_t size);
+	const void* data() const;
 
     /* Constructs the file from the given file, at the specified range.
      *  @file:  file that this file is contained in.
@@ -112,6 +180,67 @@ public:
     SubFile(IFile* file, const std::string& subfilename, unsigned long start, unsigned long size);
 };
 
+/* IFile decorator that reads the underlying file in large blocks and keeps a
+ * small number of the most recently used blocks cached. Use this for files
+ * that are parsed with many small reads. Writes go straight through to the
+ * underlying file.
+ */
+class BufferedFile : public IFile
+{
+    struct Block
+    {
+        unsigned long offset;   // Start of the block in the file, or -1 if unused
+        size_t        size;     // Number of valid bytes in the block
+        unsigned long lastUse;  // Time of last use, for LRU replacement
+        Buffer<char>  data;
+    };
+
+	IFile*             m_file;
+	std::vector<Block> m_blocks;
+	size_t             m_blockSize;
+	size_t             m_size;
+	unsigned long      m_offset;
+	unsigned long      m_time;
+
+	const Block& GetBlock(unsigned long offset);
+	~BufferedFile();
+public:
+	static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+	static const size_t DEFAULT_NUM_BLOCKS = 4;
+
+    // Functions inherited from IFile
+	bool eof() const;
+	size_t size() const;
+	unsigned long tell() const;
+	unsigned long seek(unsigned long pos);
+	unsigned long skip(long count);
+	size_t read(void* buffer, size_t size);
+	size_t readAt(unsigned long offset, void* buffer, size_t size) const;
+	size_t write(const void* buffer, size_t size);
+	const void* data() const;
+
+    /* Constructs the buffered file on top of the given file.
+     * The buffered file starts at the current position of @file.
+     *  @file:      file to buffer.
+     *  @blockSize: size, in bytes, of the blocks read from @file.
+     *  @numBlocks: maximum number of blocks to keep cached.
+     */
+    BufferedFile(IFile* file, size_t blockSize = DEFAULT_BLOCK_SIZE, size_t numBlocks = DEFAULT_NUM_BLOCKS);
+};
+
+/* Returns @file if it is memory-resident (see IFile::data()), otherwise a
+ * BufferedFile with the default settings on top of it.
+ */
+ptr<IFile> MakeBuffered(ptr<IFile> file);
+
+/* Opens a physical file for reading, preferably as a MappedFile. If the file
+ * exists but cannot be mapped (e.g., because there is not enough contiguous
+ * address space), a PhysicalFile is returned instead.
+ * If the file cannot be found, a FileNotFoundException will be thrown.
+ *  @filename: path of the file.
+ */
+ptr<IFile> OpenMappedFile(const std::wstring& filename);
+
 };
 
 #endif
\ No newline at end of file
@@ -1,7 +1,7 @@
 #include "Assets/MegaFile.h"
-#include "General/ExactTypes.h"
 #include "General/Exceptions.h"
 #include "General/Utils.h"
+#include <algorithm>
 #include <vector>
 using namespace Alamo;
 using namespace std;
@@ -14,6 +14,16 @@ struct MEGHEADER
 	uint32_t numFiles;
 };
 
+// In the later formats, the original header holds MEG_FLAGS_* and MEG_ID
+// and is followed by this. Version 3 then adds the size of the string table.
+struct MEGHEADER2
+{
+	uint32_t dataStart;
+	uint32_t numStrings;
+	uint32_t numFiles;
+};
+
+// Version 1 and 2 file table entry
 struct MEGFILEINFO
 {
 	uint32_t crc;
@@ -22,108 +32,281 @@ struct MEGFILEINFO
 	uint32_t start;
 	uint32_t nameIndex;
 };
-#pragma pack()
 
-// Represents a file in a MegaFile
-struct MegaFile::FileInfo
+// Version 3 file table entry
+struct MEGFILEINFO3
 {
-    string        m_name;
-	unsigned long m_start;
-	unsigned long m_size;
+	uint16_t flags;
+	uint32_t crc;
+	uint32_t index;
+	uint32_t size;
+	uint32_t start;
+	uint16_t nameIndex;
 };
+#pragma pack()
 
-size_t MegaFile::GetNumFiles() const
-{
-    return m_files.size();
-}
-
-const string& MegaFile::GetFilename(size_t index) const
-{
-    return m_files[index].m_name;
-}
-
-ptr<IFile> MegaFile::GetFile(size_t index) const
-{
-    return new SubFile(m_file, m_files[index].m_name, m_files[index].m_start, m_files[index].m_size);
-}
+static const uint32_t MEG_FLAGS_NORMAL    = 0xFFFFFFFF;
+static const uint32_t MEG_FLAGS_ENCRYPTED = 0x8FFFFFFF;
+static const uint32_t MEG_ID              = 0x3F7D70A4;
 
-ptr<IFile> MegaFile::GetFile(const std::string& path) const
+/*
+ * MegaFileTable class
+ */
+size_t MegaFileTable::Find(const string& name) const
 {
-    // Uppercase and replace slash with backslash
-    string name = Uppercase(path);
-    string::size_type ofs = 0;
-    while ((ofs = name.find_first_of("/", ofs)) != string::npos)
-    {
-        name[ofs] = '\\';
-    }
-    
-    unsigned long crc = crc32(name.c_str(), name.length());
-    FileIndex::const_iterator p = m_fileIndex.lower_bound(crc);
-    while (p != m_fileIndex.end() && p->first == crc)
+    const uint32_t* crcs = m_fields[FIELD_CRC];
+    uint32_t        crc  = crc32(name.c_str(), name.length());
+    for (size_t i = lower_bound(crcs, crcs + m_nFiles, crc) - crcs; i < m_nFiles && crcs[i] == crc; i++)
     {
-        if (p->second->m_name == name)
+        if (strcmp(GetFilename(i), name.c_str()) == 0)
         {
             // Found it
-            return new SubFile(m_file, p->second->m_name, p->second->m_start, p->second->m_size);
+            return i;
         }
-        p++;
     }
-
-    // File not found
-    return NULL;
+    return -1;
 }
 
-MegaFile::MegaFile(ptr<IFile> file)
-    : m_file(file)
+void MegaFileTable::Read(ptr<IFile> _file)
 {
+    // The header and filenames are read with lots of small reads
+    ptr<IFile> file = MakeBuffered(_file);
+
 	MEGHEADER header;
 	if (file->read(&header, sizeof(header)) != sizeof(header))
 	{
 		throw ReadException();
 	}
 
+	unsigned long numStrings = letohl(header.numStrings);
+	unsigned long numFiles   = letohl(header.numFiles);
+    int           version    = 1;
+    if ((numStrings == MEG_FLAGS_NORMAL || numStrings == MEG_FLAGS_ENCRYPTED) && numFiles == MEG_ID)
+    {
+        if (numStrings == MEG_FLAGS_ENCRYPTED)
+        {
+            // We don't have the keys for these
+            throw BadFileException();
+        }
+
+        MEGHEADER2 header2;
+        if (file->read(&header2, sizeof(header2)) != sizeof(header2))
+        {
+            throw ReadException();
+        }
+        numStrings = letohl(header2.numStrings);
+        numFiles   = letohl(header2.numFiles);
+        version    = 2;
+
+        // Versions 2 and 3 can only be told apart by checking if the tables
+        // end at the file data when we assume the extra field of version 3.
+        const unsigned long headerSize = sizeof(MEGHEADER) + sizeof(MEGHEADER2);
+        uint32_t stringTableSize;
+        if (file->read(&stringTableSize, sizeof(uint32_t)) == sizeof(uint32_t) &&
+            headerSize + sizeof(uint32_t) + (uint64_t)letohl(stringTableSize) + (uint64_t)numFiles * sizeof(MEGFILEINFO3) == letohl(header2.dataStart))
+        {
+            version = 3;
+        }
+        else
+        {
+            // It's part of the string table
+            file->seek(headerSize);
+        }
+    }
+
+    if (numStrings > file->size() / sizeof(uint16_t) || numFiles > file->size() / sizeof(MEGFILEINFO))
+    {
+        // Don't try to allocate tables that can't possibly fit in the file
+        throw BadFileException();
+    }
+
 	//
-	// Read filenames
+	// Read filenames into the string pool
 	//
-	unsigned long numStrings = letohl(header.numStrings);
-	vector<string> filenames(numStrings);
-	size_t pos = 0;
+    Buffer<uint32_t> filenames(numStrings);
+    m_nameData.clear();
 	for (unsigned long i = 0; i < numStrings; i++)
 	{
-		uint16_t length;
-		if (file->read(&length, sizeof(uint16_t)) != sizeof(uint16_t))
+		uint16_t leLength;
+		if (file->read(&leLength, sizeof(uint16_t)) != sizeof(uint16_t))
 		{
 			throw ReadException();
 		}
+        size_t length = letohs(leLength);
+        size_t pos    = m_nameData.size();
+        filenames[i]  = (uint32_t)pos;
 
-		Buffer<char> data(length);
-		if (file->read(data, length) != length)
-		{
-			throw ReadException();
-		}
-		filenames[i] = string(data, length);
-	}
+        // Grow the string pool geometrically
+        if (pos + length + 1 > m_nameData.capacity())
+        {
+            m_nameData.reserve(max(pos + length + 1, 2 * m_nameData.capacity()));
+        }
+        m_nameData.resize(pos + length + 1);
+
+        if (file->read(&m_nameData[pos], length) != length)
+        {
+            throw ReadException();
+        }
+        m_nameData[pos + length] = '\0';
+    }
 
 	//
 	// Read master index table
 	//
-	unsigned long numFiles  = letohl(header.numFiles);
 	Buffer<MEGFILEINFO> info(numFiles);
 	if (file->read(info, numFiles * sizeof(MEGFILEINFO)) != numFiles * sizeof(MEGFILEINFO))
 	{
 		throw ReadException();
 	}
 
-    // Unpack and store
-    m_files.resize(numFiles);
+    if (version == 3)
+    {
+        // Same size, different layout; convert in place
+        for (unsigned long i = 0; i < numFiles; i++)
+        {
+            MEGFILEINFO3 fi3;
+            memcpy(&fi3, &info[i], sizeof(MEGFILEINFO3));
+            if (letohs(fi3.flags) != 0)
+            {
+                // Encrypted file
+                throw BadFileException();
+            }
+            info[i].crc       = fi3.crc;
+            info[i].index     = fi3.index;
+            info[i].size      = fi3.size;
+            info[i].start     = fi3.start;
+            info[i].nameIndex = htolel(letohs(fi3.nameIndex));
+        }
+    }
+
+    // The table is normally sorted already, but we rely on it, so make sure.
+    // A stable sort keeps the first of any duplicate names first.
+    vector<uint32_t> order(numFiles);
+    bool sorted = true;
+    for (unsigned long i = 0; i < numFiles; i++)
+    {
+        order[i] = i;
+        sorted   = sorted && (i == 0 || letohl(info[i - 1].crc) <= letohl(info[i].crc));
+    }
+    if (!sorted)
+    {
+        stable_sort(order.begin(), order.end(), [&info](uint32_t a, uint32_t b) {
+            return letohl(info[a].crc) < letohl(info[b].crc);
+        });
+    }
+
+    // Unpack into the separate fields
+    const uint64_t fileSize = _file->size();
+    m_fieldData.resize(NUM_FIELDS * numFiles);
+    uint32_t* fields[NUM_FIELDS];
+    for (int f = 0; f < NUM_FIELDS; f++)
+    {
+        fields[f] = m_fieldData + f * numFiles;
+    }
+
 	for (unsigned long i = 0; i < numFiles; i++)
 	{
-		FileInfo& fi = m_files[i];
-        fi.m_name  = filenames[letohl(info[i].nameIndex)];
-		fi.m_start = letohl(info[i].start);
-		fi.m_size  = letohl(info[i].size);
-
-        // Not found, add it
-        m_fileIndex.insert(make_pair(letohl(info[i].crc), &fi));
+        const MEGFILEINFO& fi = info[order[i]];
+        unsigned long nameIndex = letohl(fi.nameIndex);
+        if (nameIndex >= numStrings || (uint64_t)letohl(fi.start) + letohl(fi.size) > fileSize)
+        {
+            throw BadFileException();
+        }
+        fields[FIELD_CRC  ][i] = letohl(fi.crc);
+        fields[FIELD_START][i] = letohl(fi.start);
+        fields[FIELD_SIZE ][i] = letohl(fi.size);
+        fields[FIELD_NAME ][i] = filenames[nameIndex];
 	}
+
+    for (int f = 0; f < NUM_FIELDS; f++)
+    {
+        m_fields[f] = fields[f];
+    }
+    m_nFiles    = numFiles;
+    m_names     = m_nameData;
+    m_namesSize = m_nameData.size();
+}
+
+void MegaFileTable::Attach(const uint32_t* const* fields, size_t nFiles, const char* names, size_t namesSize)
+{
+    m_fieldData.clear();
+    m_nameData.clear();
+    for (int f = 0; f < NUM_FIELDS; f++)
+    {
+        m_fields[f] = fields[f];
+    }
+    m_nFiles    = nFiles;
+    m_names     = names;
+    m_namesSize = namesSize;
+}
+
+void MegaFileTable::Detach()
+{
+    if (m_names != NULL && m_names != m_nameData)
+    {
+        m_fieldData.resize(NUM_FIELDS * m_nFiles);
+        for (int f = 0; f < NUM_FIELDS; f++)
+        {
+            uint32_t* field = m_fieldData + f * m_nFiles;
+            memcpy(field, m_fields[f], m_nFiles * sizeof(uint32_t));
+            m_fields[f] = field;
+        }
+        m_nameData.resize(m_namesSize);
+        memcpy(m_nameData, m_names, m_namesSize);
+        m_names = m_nameData;
+    }
+}
+
+MegaFileTable::MegaFileTable()
+{
+    for (int f = 0; f < NUM_FIELDS; f++)
+    {
+        m_fields[f] = NULL;
+    }
+    m_names     = NULL;
+    m_nFiles    = 0;
+    m_namesSize = 0;
+}
+
+/*
+ * MegaFile class
+ */
+size_t MegaFile::GetNumFiles() const
+{
+    return m_table.GetNumFiles();
+}
+
+const char* MegaFile::GetFilename(size_t index) const
+{
+    return m_table.GetFilename(index);
+}
+
+ptr<IFile> MegaFile::GetFile(size_t index) const
+{
+    return new SubFile(m_file, m_table.GetFilename(index), m_table.GetStart(index), m_table.GetSize(index));
+}
+
+ptr<IFile> MegaFile::GetFile(const std::string& path) const
+{
+    // Uppercase and replace slash with backslash
+    string name = Uppercase(path);
+    string::size_type ofs = 0;
+    while ((ofs = name.find_first_of("/", ofs)) != string::npos)
+    {
+        name[ofs] = '\\';
+    }
+    
+    size_t index = m_table.Find(name);
+    if (index == -1)
+    {
+        // File not found
+        return NULL;
+    }
+    return GetFile(index);
+}
+
+MegaFile::MegaFile(ptr<IFile> file)
+    : m_file(file)
+{
+    m_table.Read(file);
 }
@@ -2,24 +2,82 @@
 #define MEGAFILE_H
 
 #include "Files.h"
-#include <map>
-#include <vector>
+#include "General/ExactTypes.h"
 
 namespace Alamo {
 
-class MegaFile : public IObject
+/* Compact index of the files in a MegaFile. The file table is kept sorted on
+ * CRC, with every field in an array of its own, and all filenames share a
+ * single string pool. The arrays are either owned by the table or live in
+ * memory owned by someone else (e.g., a mapped cache), see Attach().
+ */
+class MegaFileTable
 {
-    struct FileInfo;
-    typedef std::multimap<unsigned long, FileInfo*> FileIndex;
-    typedef std::vector<FileInfo> FileList;
+public:
+    // The fields of the file table; each is an array of GetNumFiles() values
+    enum Field
+    {
+        FIELD_CRC,      // CRC of the filename
+        FIELD_START,    // Offset of the file's data in the MegaFile
+        FIELD_SIZE,     // Size of the file's data
+        FIELD_NAME,     // Offset of the filename in the string pool
+        NUM_FIELDS
+    };
+
+    size_t          GetNumFiles() const              { return m_nFiles; }
+    uint32_t        GetCRC(size_t index) const       { return m_fields[FIELD_CRC][index]; }
+    uint32_t        GetStart(size_t index) const     { return m_fields[FIELD_START][index]; }
+    uint32_t        GetSize(size_t index) const      { return m_fields[FIELD_SIZE][index]; }
+    const char*     GetFilename(size_t index) const  { return m_names + m_fields[FIELD_NAME][index]; }
+    const uint32_t* GetField(Field field) const      { return m_fields[field]; }
+    const char*     GetNames() const                 { return m_names; }
+    size_t          GetNamesSize() const             { return m_namesSize; }
+
+    /* Returns the index of the file with the given uppercased, backslashed
+     * name, or -1 if the table does not contain it.
+     */
+    size_t Find(const std::string& name) const;
+
+    /* Reads the table from the header of a MegaFile. Versions 1 to 3 of the
+     * format are supported, but not encrypted MegaFiles.
+     * Throws a ReadException if the header could not be read and a
+     * BadFileException if the header is invalid.
+     */
+    void Read(ptr<IFile> file);
+
+    /* Makes the table refer to external arrays, which must be sorted on CRC
+     * and remain valid for as long as they are used by the table.
+     *  @fields:    NUM_FIELDS arrays of @nFiles values each.
+     *  @names:     string pool of @namesSize bytes that the names refer to.
+     */
+    void Attach(const uint32_t* const* fields, size_t nFiles, const char* names, size_t namesSize);
+
+    // Copies any external arrays into the table itself
+    void Detach();
 
-    ptr<IFile> m_file;
-    FileList   m_files;
-    FileIndex  m_fileIndex;
+    MegaFileTable();
+
+private:
+    const uint32_t*  m_fields[NUM_FIELDS];
+    const char*      m_names;
+    size_t           m_nFiles;
+    size_t           m_namesSize;
+    Buffer<uint32_t> m_fieldData;
+    Buffer<char>     m_nameData;
+
+    // Tables point into their own buffers, so they cannot be copied
+    MegaFileTable(const MegaFileTable&);
+    MegaFileTable& operator=(const MegaFileTable&);
+};
+
+class MegaFile : public IObject
+{
+    ptr<IFile>    m_file;
+    MegaFileTable m_table;
 
 public:
     size_t GetNumFiles() const;
-    const std::string& GetFilename(size_t index) const;
+    const char* GetFilename(size_t index) const;
     ptr<IFile> GetFile(size_t index) const;
     ptr<IFile> GetFile(const std::string& path) const;
 
@@ -27,4 +85,4 @@ public:
 };
 
 }
-#endif
\ No newline at end of file
+#endif
@@ -1,5 +1,8 @@
 #include <algorithm>
+#include <exception>
 #include <stack>
+#include <stddef.h>
+#include <type_traits>
 #include "Assets/Models.h"
 #include "General/Exceptions.h"
 #include "General/Utils.h"
@@ -19,6 +22,7 @@ void Model::ReadBone(ChunkReader& reader, Bone& bone)
     Verify(type == 0x205 || type == 0x206);
 
     long parent = reader.readInteger();
+    Verify(parent < (long)m_bones.size());
     bone.parent    = (parent >= 0) ? &m_bones[parent] : NULL;
     bone.visible   = (reader.readInteger() != 0);
     bone.billboard = BBT_DISABLE;
@@ -35,12 +39,6 @@ void Model::ReadBone(ChunkReader& reader, Bone& bone)
     }
     bone.relTransform.transpose();
 
-    // Calculate absolute transform
-    bone.absTransform = (bone.parent != NULL)
-        ? bone.relTransform * bone.parent->absTransform
-        : bone.relTransform;
-    bone.invAbsTransform = bone.absTransform.inverse();
-
     Verify(reader.next() == -1);
 }
 
@@ -60,9 +58,389 @@ void Model::ReadSkeleton(ChunkReader& reader)
         m_bones[i].index   = i;
     }
     Verify(reader.next() == -1);
+
+    BuildBoneIndex();
+    BuildSkeleton();
+}
+
+// Flattens the bones into m_skeleton, parents first
+void Model::BuildSkeleton()
+{
+    const size_t nBones = m_bones.size();
+    m_skeleton.bones           .resize(nBones);
+    m_skeleton.entries         .resize(nBones);
+    m_skeleton.parents         .resize(nBones);
+    m_skeleton.scales          .resize(nBones);
+    m_skeleton.rotations       .resize(nBones);
+    m_skeleton.translations    .resize(nBones);
+    m_skeleton.absTransforms   .resize(nBones);
+    m_skeleton.invAbsTransforms.resize(nBones);
+
+    // Place bones in file order, but hold back bones until their parent is
+    // placed. For files that have parents first, this takes a single pass.
+    for (size_t i = 0; i < nBones; i++)
+    {
+        m_skeleton.entries[i] = -1;
+    }
+
+    size_t nPlaced = 0;
+    while (nPlaced < nBones)
+    {
+        const size_t start = nPlaced;
+        for (size_t i = 0; i < nBones; i++)
+        {
+            const Bone& bone = m_bones[i];
+            if (m_skeleton.entries[i] == -1 && (bone.parent == NULL || m_skeleton.entries[bone.parent->index] != -1))
+            {
+                m_skeleton.entries[i]       = nPlaced;
+                m_skeleton.bones  [nPlaced] = i;
+                nPlaced++;
+            }
+        }
+        // No progress means the hierarchy has a cycle
+        Verify(nPlaced > start);
+    }
+
+    for (size_t e = 0; e < nBones; e++)
+    {
+        const Bone& bone   = m_bones[m_skeleton.bones[e]];
+        Matrix      rel    = bone.relTransform;
+        size_t      parent = (bone.parent != NULL) ? m_skeleton.entries[bone.parent->index] : -1;
+
+        rel.decompose(&m_skeleton.scales[e], &m_skeleton.rotations[e], &m_skeleton.translations[e]);
+        m_skeleton.parents[e]          = parent;
+        m_skeleton.absTransforms[e]    = (parent != -1) ? bone.relTransform * m_skeleton.absTransforms[parent] : bone.relTransform;
+        m_skeleton.invAbsTransforms[e] = m_skeleton.absTransforms[e].inverse();
+    }
+}
+
+static inline char BoneNameChar(char c)
+{
+    return (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+}
+
+// Case-insensitive FNV-1a hash
+static size_t HashBoneName(string_view name)
+{
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < name.length(); i++)
+    {
+        hash = (hash ^ (unsigned char)BoneNameChar(name[i])) * 16777619U;
+    }
+    return hash;
+}
+
+static bool BoneNameEquals(const string& bone, string_view name)
+{
+    if (bone.length() != name.length())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < name.length(); i++)
+    {
+        if (BoneNameChar(bone[i]) != BoneNameChar(name[i]))
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
-void Model::ReadSubMesh(ChunkReader& reader, SubMesh& mesh)
+// Builds the open-addressing hash table for GetBone(name)
+void Model::BuildBoneIndex()
+{
+    // Keep the table at most half full
+    size_t size = 16;
+    while (size < 2 * m_bones.size())
+    {
+        size *= 2;
+    }
+    m_boneIndex.assign(size, -1);
+
+    for (size_t i = 0; i < m_bones.size(); i++)
+    {
+        size_t slot = HashBoneName(m_bones[i].name) & (size - 1);
+        while (m_boneIndex[slot] != -1 && !BoneNameEquals(m_bones[m_boneIndex[slot]].name, m_bones[i].name))
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+
+        if (m_boneIndex[slot] == -1)
+        {
+            // If names are duplicated, the first bone wins
+            m_boneIndex[slot] = i;
+        }
+    }
+}
+
+#pragma pack(1)
+// Vertex format of the old 0x10005 vertex chunk
+struct OldVertex
+{
+    Vector3 Position;
+    Vector3 Normal;
+    Vector2 TexCoord[4];
+    Vector3 Tangent;
+    Vector3 Binormal;
+    Color   Color;
+    DWORD   BoneIndices[4];
+    float   BoneWeights[4];
+};
+#pragma pack()
+
+// The separate elements of a vertex
+enum VertexElementType
+{
+    VE_POSITION,
+    VE_NORMAL,
+    VE_TEXCOORD0, VE_TEXCOORD1, VE_TEXCOORD2, VE_TEXCOORD3,
+    VE_TANGENT,
+    VE_BINORMAL,
+    VE_COLOR,
+    VE_BONEINDEX0,  VE_BONEINDEX1,  VE_BONEINDEX2,  VE_BONEINDEX3,
+    VE_BONEWEIGHT0, VE_BONEWEIGHT1, VE_BONEWEIGHT2, VE_BONEWEIGHT3,
+    NUM_VERTEX_ELEMENTS
+};
+
+#define VE(x) (1UL << (x))
+static const unsigned long VE_TEXCOORDS    = VE(VE_TEXCOORD0)   | VE(VE_TEXCOORD1)   | VE(VE_TEXCOORD2)   | VE(VE_TEXCOORD3);
+static const unsigned long VE_TANGENTS     = VE(VE_TANGENT)     | VE(VE_BINORMAL);
+static const unsigned long VE_BONEINDICES  = VE(VE_BONEINDEX0)  | VE(VE_BONEINDEX1)  | VE(VE_BONEINDEX2)  | VE(VE_BONEINDEX3);
+static const unsigned long VE_BONEWEIGHTS  = VE(VE_BONEWEIGHT0) | VE(VE_BONEWEIGHT1) | VE(VE_BONEWEIGHT2) | VE(VE_BONEWEIGHT3);
+static const unsigned long VE_ALL          = VE(NUM_VERTEX_ELEMENTS) - 1;
+
+// Where each element is found in the vertices in the file
+static const struct {
+    size_t offset;
+    size_t oldOffset;
+    size_t size;
+} VertexElements[NUM_VERTEX_ELEMENTS] = {
+    {offsetof(MASTER_VERTEX, Position),                          offsetof(OldVertex, Position),                          sizeof(Vector3)},
+    {offsetof(MASTER_VERTEX, Normal),                            offsetof(OldVertex, Normal),                            sizeof(Vector3)},
+    {offsetof(MASTER_VERTEX, TexCoord)    + 0 * sizeof(Vector2), offsetof(OldVertex, TexCoord)    + 0 * sizeof(Vector2), sizeof(Vector2)},
+    {offsetof(MASTER_VERTEX, TexCoord)    + 1 * sizeof(Vector2), offsetof(OldVertex, TexCoord)    + 1 * sizeof(Vector2), sizeof(Vector2)},
+    {offsetof(MASTER_VERTEX, TexCoord)    + 2 * sizeof(Vector2), offsetof(OldVertex, TexCoord)    + 2 * sizeof(Vector2), sizeof(Vector2)},
+    {offsetof(MASTER_VERTEX, TexCoord)    + 3 * sizeof(Vector2), offsetof(OldVertex, TexCoord)    + 3 * sizeof(Vector2), sizeof(Vector2)},
+    {offsetof(MASTER_VERTEX, Tangent),                           offsetof(OldVertex, Tangent),                           sizeof(Vector3)},
+    {offsetof(MASTER_VERTEX, Binormal),                          offsetof(OldVertex, Binormal),                          sizeof(Vector3)},
+    {offsetof(MASTER_VERTEX, Color),                             offsetof(OldVertex, Color),                             sizeof(Color)},
+    {offsetof(MASTER_VERTEX, BoneIndices) + 0 * sizeof(DWORD),   offsetof(OldVertex, BoneIndices) + 0 * sizeof(DWORD),   sizeof(DWORD)},
+    {offsetof(MASTER_VERTEX, BoneIndices) + 1 * sizeof(DWORD),   offsetof(OldVertex, BoneIndices) + 1 * sizeof(DWORD),   sizeof(DWORD)},
+    {offsetof(MASTER_VERTEX, BoneIndices) + 2 * sizeof(DWORD),   offsetof(OldVertex, BoneIndices) + 2 * sizeof(DWORD),   sizeof(DWORD)},
+    {offsetof(MASTER_VERTEX, BoneIndices) + 3 * sizeof(DWORD),   offsetof(OldVertex, BoneIndices) + 3 * sizeof(DWORD),   sizeof(DWORD)},
+    {offsetof(MASTER_VERTEX, BoneWeights) + 0 * sizeof(float),   offsetof(OldVertex, BoneWeights) + 0 * sizeof(float),   sizeof(float)},
+    {offsetof(MASTER_VERTEX, BoneWeights) + 1 * sizeof(float),   offsetof(OldVertex, BoneWeights) + 1 * sizeof(float),   sizeof(float)},
+    {offsetof(MASTER_VERTEX, BoneWeights) + 2 * sizeof(float),   offsetof(OldVertex, BoneWeights) + 2 * sizeof(float),   sizeof(float)},
+    {offsetof(MASTER_VERTEX, BoneWeights) + 3 * sizeof(float),   offsetof(OldVertex, BoneWeights) + 3 * sizeof(float),   sizeof(float)},
+};
+
+// The elements that each vertex format uses
+static const struct {
+    const char*   name;
+    unsigned long elements;
+} VertexFormatElements[] = {
+    {"alD3dVertN",             VE(VE_NORMAL)},
+    {"alD3dVertNU2",           VE(VE_NORMAL) | VE(VE_TEXCOORD0)},
+    {"alD3dVertNU2C",          VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE(VE_COLOR)},
+    {"alD3dVertNU2U3U3",       VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE_TANGENTS},
+    {"alD3dVertNU2U3U3C",      VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE_TANGENTS | VE(VE_COLOR)},
+    {"alD3dVertRSkinNU2",      VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE(VE_BONEINDEX0)},
+    {"alD3dVertRSkinNU2C",     VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE(VE_BONEINDEX0) | VE(VE_COLOR)},
+    {"alD3dVertRSkinNU2U3U3",  VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE(VE_BONEINDEX0) | VE_TANGENTS},
+    {"alD3dVertRSkinNU2U3U3C", VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE(VE_BONEINDEX0) | VE_TANGENTS | VE(VE_COLOR)},
+    {"alD3dVertB4I4NU2",       VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE_BONEINDICES | VE_BONEWEIGHTS},
+    {"alD3dVertB4I4NU2C",      VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE_BONEINDICES | VE_BONEWEIGHTS | VE(VE_COLOR)},
+    {"alD3dVertB4I4NU2U3U3",   VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE_BONEINDICES | VE_BONEWEIGHTS | VE_TANGENTS},
+    {"alD3dVertB4I4NU2U3U3C",  VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE_BONEINDICES | VE_BONEWEIGHTS | VE_TANGENTS | VE(VE_COLOR)},
+    {"alD3dVertGrass",         VE(VE_TEXCOORD0) | VE(VE_TEXCOORD1)},
+    // Billboards keep their center in the bone weights
+    {"alD3dVertBillboard",     VE(VE_NORMAL) | VE(VE_TEXCOORD0) | VE(VE_BONEWEIGHT0) | VE(VE_BONEWEIGHT1) | VE(VE_BONEWEIGHT2)},
+    {NULL}
+};
+
+static unsigned long GetVertexElements(const string& format)
+{
+    for (int i = 0; VertexFormatElements[i].name != NULL; i++)
+    {
+        if (_stricmp(VertexFormatElements[i].name, format.c_str()) == 0)
+        {
+            return VE(VE_POSITION) | VertexFormatElements[i].elements;
+        }
+    }
+    // Unknown format, keep everything
+    return VE_ALL;
+}
+
+// Returns the size of a vertex with only the specified elements
+static size_t GetVertexSize(unsigned long elements)
+{
+    size_t size = 0;
+    for (int i = 0; i < NUM_VERTEX_ELEMENTS; i++)
+    {
+        if (elements & VE(i))
+        {
+            size += VertexElements[i].size;
+        }
+    }
+    return size;
+}
+
+// Reads vertices of type @T from @file and keeps only the specified elements
+template <typename T>
+static void ReadVertices(IFile* file, unsigned long offset, size_t count, unsigned long elements, char* dest)
+{
+    static const size_t BLOCK_SIZE = 1024;
+
+    const bool old = is_same<T, OldVertex>::value;
+    Buffer<T>  block(min(count, BLOCK_SIZE));
+    for (size_t start = 0; start < count; start += BLOCK_SIZE)
+    {
+        const size_t n = min(count - start, BLOCK_SIZE);
+        if (file->readAt(offset + (unsigned long)(start * sizeof(T)), block, n * sizeof(T)) != n * sizeof(T))
+        {
+            throw ReadException();
+        }
+
+        for (size_t v = 0; v < n; v++)
+        {
+            const char* src = (const char*)&block[v];
+            for (int i = 0; i < NUM_VERTEX_ELEMENTS; i++)
+            {
+                if (elements & VE(i))
+                {
+                    memcpy(dest, src + (old ? VertexElements[i].oldOffset : VertexElements[i].offset), VertexElements[i].size);
+                    dest += VertexElements[i].size;
+                }
+            }
+        }
+    }
+}
+
+// Returns a pointer to @size bytes at @offset in the file's mapping, if the
+// file is mapped and the data is suitably aligned for @T.
+template <typename T>
+static const T* GetMappedData(IFile* file, unsigned long offset, size_t size)
+{
+    const char* data = (const char*)file->data();
+    if (data != NULL && offset + size <= file->size() && (size_t)(data + offset) % sizeof(float) == 0)
+    {
+        return (const T*)(data + offset);
+    }
+    return NULL;
+}
+
+void Model::SubMesh::LoadVertices() const
+{
+    m_mappedVertices = NULL;
+    if (m_vertexChunk == 0x10007 && m_elements == VE_ALL)
+    {
+        // The format needs the whole vertex, use it straight from the file if we can
+        m_mappedVertices = GetMappedData<MASTER_VERTEX>(m_file, m_vertexOffset, nVertices * sizeof(MASTER_VERTEX));
+    }
+
+    if (m_mappedVertices == NULL)
+    {
+        m_vertices.resize(nVertices * GetVertexSize(m_elements));
+        if (m_vertexChunk == 0x10007) {
+            ReadVertices<MASTER_VERTEX>(m_file, m_vertexOffset, nVertices, m_elements, m_vertices);
+        } else {
+            ReadVertices<OldVertex>(m_file, m_vertexOffset, nVertices, m_elements, m_vertices);
+        }
+    }
+    m_hasVertices = true;
+}
+
+void Model::SubMesh::LoadIndices() const
+{
+#ifdef LITTLE_ENDIAN
+    m_mappedIndices = GetMappedData<uint16_t>(m_file, m_indexOffset, nIndices * sizeof(uint16_t));
+#else
+    m_mappedIndices = NULL;
+#endif
+    if (m_mappedIndices == NULL)
+    {
+        m_indices.resize(nIndices);
+        if (m_file->readAt(m_indexOffset, m_indices, nIndices * sizeof(uint16_t)) != nIndices * sizeof(uint16_t))
+        {
+            throw ReadException();
+        }
+        for (size_t i = 0; i < nIndices; i++)
+        {
+            m_indices[i] = letohs(m_indices[i]);
+        }
+    }
+    m_hasIndices = true;
+}
+
+bool Model::SubMesh::UseVertexFormat(const string& format) const
+{
+    if ((GetVertexElements(format) & ~m_elements) == 0)
+    {
+        return true;
+    }
+
+    // Keep everything, we can't tell which of the missing elements get used
+    m_elements    = VE_ALL;
+    m_hasVertices = false;
+    m_vertices.resize(0);
+    return false;
+}
+
+VERTEX_ELEMENTS Model::SubMesh::GetVertices() const
+{
+    static const float Zero[4]  = {0.0f, 0.0f, 0.0f, 0.0f};
+    static const float White[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    if (!m_hasVertices)
+    {
+        LoadVertices();
+    }
+
+    // Find every element in the stored vertices
+    const void* data  [NUM_VERTEX_ELEMENTS];
+    size_t      stride[NUM_VERTEX_ELEMENTS];
+    size_t      offset = 0;
+    size_t      size   = GetVertexSize(m_elements);
+    for (int i = 0; i < NUM_VERTEX_ELEMENTS; i++)
+    {
+        if (m_mappedVertices != NULL) {
+            data[i]   = (const char*)m_mappedVertices + VertexElements[i].offset;
+            stride[i] = sizeof(MASTER_VERTEX);
+        } else if (m_elements & VE(i)) {
+            data[i]   = m_vertices + offset;
+            stride[i] = size;
+            offset   += VertexElements[i].size;
+        } else {
+            data[i]   = (i == VE_COLOR) ? White : Zero;
+            stride[i] = 0;
+        }
+    }
+
+    VERTEX_ELEMENTS elements;
+    elements.Position = VertexElement<Vector3>(data[VE_POSITION], stride[VE_POSITION]);
+    elements.Normal   = VertexElement<Vector3>(data[VE_NORMAL],   stride[VE_NORMAL]);
+    elements.Tangent  = VertexElement<Vector3>(data[VE_TANGENT],  stride[VE_TANGENT]);
+    elements.Binormal = VertexElement<Vector3>(data[VE_BINORMAL], stride[VE_BINORMAL]);
+    elements.Color    = VertexElement<Color>  (data[VE_COLOR],    stride[VE_COLOR]);
+    for (int i = 0; i < 4; i++)
+    {
+        elements.TexCoord[i]    = VertexElement<Vector2>(data[VE_TEXCOORD0   + i], stride[VE_TEXCOORD0   + i]);
+        elements.BoneIndices[i] = VertexElement<DWORD>  (data[VE_BONEINDEX0  + i], stride[VE_BONEINDEX0  + i]);
+        elements.BoneWeights[i] = VertexElement<float>  (data[VE_BONEWEIGHT0 + i], stride[VE_BONEWEIGHT0 + i]);
+    }
+    return elements;
+}
+
+const uint16_t* Model::SubMesh::GetIndices() const
+{
+    if (!m_hasIndices)
+    {
+        LoadIndices();
+    }
+    return (m_mappedIndices != NULL) ? m_mappedIndices : m_indices;
+}
+
+void Model::ReadSubMesh(ChunkReader& reader, ptr<IFile> file, SubMesh& mesh)
 {
     Verify(reader.next() == 0x10100);
     
@@ -98,56 +476,26 @@ void Model::ReadSubMesh(ChunkReader& reader, SubMesh& mesh)
     
     // Read vertex and primitive count
     Verify(reader.next() == 0x10001);
-    mesh.vertices.resize(reader.readInteger());
-    mesh.indices .resize(reader.readInteger() * 3);
+    mesh.nVertices = reader.readInteger();
+    mesh.nIndices  = reader.readInteger() * 3;
 
     // Read vertex format
     Verify(reader.next() == 0x10002);
     mesh.vertexFormat = reader.readString();
+    mesh.m_elements   = GetVertexElements(mesh.vertexFormat);
 
-    type = reader.next();
-    Verify(type == 0x10007 || type == 0x10005);
-    if (type == 0x10007)
-    {
-        reader.read(mesh.vertices, mesh.vertices.size() * sizeof(MASTER_VERTEX));
-    }
-    else
-    {
-        #pragma pack(1)
-        struct OldVertex
-        {
-            Vector3 Position;
-            Vector3 Normal;
-            Vector2 TexCoord[4];
-            Vector3 Tangent;
-            Vector3 Binormal;
-            Color   Color;
-            DWORD   BoneIndices[4];
-            float   BoneWeights[4];
-        };
-        #pragma pack()
-
-        // Read and convert old format
-        Buffer<OldVertex> vertices(mesh.vertices.size());
-        reader.read(vertices, vertices.size() * sizeof(OldVertex));
-        for (size_t i = 0; i < vertices.size(); i++)
-        {
-            mesh.vertices[i].Position = vertices[i].Position;
-            mesh.vertices[i].Normal   = vertices[i].Normal;
-            mesh.vertices[i].Tangent  = vertices[i].Tangent;
-            mesh.vertices[i].Binormal = vertices[i].Binormal;
-            mesh.vertices[i].Color    = vertices[i].Color;
-            for (int j = 0; j < 4; j++)
-            {
-                mesh.vertices[i].TexCoord[j]    = vertices[i].TexCoord[j];
-                mesh.vertices[i].BoneIndices[j] = vertices[i].BoneIndices[j];
-                mesh.vertices[i].BoneWeights[j] = vertices[i].BoneWeights[j];
-            }
-        }
-    }
+    // Only remember where the vertex and index data is; it's loaded when needed
+    mesh.m_file         = file;
+    mesh.m_hasVertices  = false;
+    mesh.m_hasIndices   = false;
+    mesh.m_vertexChunk  = reader.next();
+    mesh.m_vertexOffset = reader.offset();
+    Verify(mesh.m_vertexChunk == 0x10007 || mesh.m_vertexChunk == 0x10005);
+    Verify(reader.size() >= mesh.nVertices * (mesh.m_vertexChunk == 0x10007 ? sizeof(MASTER_VERTEX) : sizeof(OldVertex)));
 
     Verify(reader.next() == 0x10004);
-    reader.read(mesh.indices, mesh.indices.size() * sizeof(uint16_t));
+    mesh.m_indexOffset = reader.offset();
+    Verify(reader.size() >= mesh.nIndices * sizeof(uint16_t));
 
     // Read skin mapping
     type = reader.next();
@@ -163,7 +511,8 @@ void Model::ReadSubMesh(ChunkReader& reader, SubMesh& mesh)
 
     if (type == 0x1200)
     {
-        // Read collision tree
+        // Skip collision tree; its layout is not known, so the mesh builds
+        // its own from the triangles when it's needed
         reader.skip();
         type = reader.next();
     }
@@ -171,37 +520,79 @@ void Model::ReadSubMesh(ChunkReader& reader, SubMesh& mesh)
     Verify(type == -1);
 }
 
-Model::Mesh* Model::ReadMesh(ChunkReader& reader)
+const CollisionTree& Model::Mesh::GetCollisionTree() const
 {
-    m_meshes.push_back(NULL);
-    Mesh* mesh = m_meshes.back() = new Mesh();
+    if (m_collisionTree == NULL)
+    {
+        ptr<CollisionTree> tree = new CollisionTree();
+        for (size_t i = 0; i < subMeshes.size(); i++)
+        {
+            const SubMesh&        submesh  = subMeshes[i];
+            const VERTEX_ELEMENTS vertices = submesh.GetVertices();
+            const uint16_t*       indices  = submesh.GetIndices();
+            for (size_t f = 0; f < submesh.nIndices / 3; f++)
+            {
+                const uint16_t* face = &indices[f * 3];
+                Verify(face[0] < submesh.nVertices && face[1] < submesh.nVertices && face[2] < submesh.nVertices);
+
+                CollisionTree::Triangle triangle = {(uint32_t)i, (uint32_t)f};
+                tree->AddTriangle(triangle, vertices.Position[face[0]], vertices.Position[face[1]], vertices.Position[face[2]]);
+            }
+        }
+        tree->Build();
+        m_collisionTree = tree;
+    }
+    return *m_collisionTree;
+}
+
+const SurfaceSampler& Model::Mesh::GetSurfaceSampler() const
+{
+    if (m_surfaceSampler == NULL)
+    {
+        ptr<SurfaceSampler> sampler = new SurfaceSampler();
+        for (size_t i = 0; i < subMeshes.size(); i++)
+        {
+            const SubMesh&        submesh  = subMeshes[i];
+            const VERTEX_ELEMENTS vertices = submesh.GetVertices();
+            const uint16_t*       indices  = submesh.GetIndices();
+            for (size_t f = 0; f < submesh.nIndices / 3; f++)
+            {
+                const uint16_t* face = &indices[f * 3];
+                Verify(face[0] < submesh.nVertices && face[1] < submesh.nVertices && face[2] < submesh.nVertices);
+                sampler->AddTriangle((uint32_t)i, face, vertices.Position[face[0]], vertices.Position[face[1]], vertices.Position[face[2]]);
+            }
+        }
+        sampler->Build();
+        m_surfaceSampler = sampler;
+    }
+    return *m_surfaceSampler;
+}
 
+void Model::ReadMesh(ChunkReader& reader, ptr<IFile> file, Mesh& mesh)
+{
     // Read mesh name
     Verify(reader.next() == 0x401);
-    mesh->name = reader.readString();
+    mesh.name = reader.readString();
     
     // Read mesh info
     Verify(reader.next() == 0x402);
-    mesh->subMeshes.resize( reader.readInteger() );
-    mesh->bounds.min   = reader.readVector3();
-    mesh->bounds.max   = reader.readVector3();
+    mesh.subMeshes.resize( reader.readInteger() );
+    mesh.bounds.min   = reader.readVector3();
+    mesh.bounds.max   = reader.readVector3();
     reader.readInteger();
-    mesh->isVisible    = (reader.readInteger() == 0);
-    mesh->isCollidable = (reader.readInteger() != 0);
-    mesh->firstSubMesh = m_numSubMeshes;
-    mesh->nVertices    = 0;
+    mesh.isVisible    = (reader.readInteger() == 0);
+    mesh.isCollidable = (reader.readInteger() != 0);
+    mesh.nVertices    = 0;
 
     // Read sub-meshes
-    for (size_t i = 0; i < mesh->subMeshes.size(); i++)
+    for (size_t i = 0; i < mesh.subMeshes.size(); i++)
     {
-        mesh->subMeshes[i].mesh = mesh;
-        ReadSubMesh(reader, mesh->subMeshes[i]);
-        mesh->nVertices += mesh->subMeshes[i].vertices.size();
-        m_numSubMeshes++;
+        mesh.subMeshes[i].mesh = &mesh;
+        ReadSubMesh(reader, file, mesh.subMeshes[i]);
+        mesh.nVertices += mesh.subMeshes[i].nVertices;
     }
 
     Verify(reader.next() == -1);
-    return mesh;
 }
 
 Model::Light* Model::ReadLight(ChunkReader& reader)
@@ -341,28 +732,169 @@ void Model::ReadConnections(ChunkReader& reader, const std::vector<Attachable*>&
     Verify(reader.next() == -1);
 }
 
-Model::Model(ptr<IFile> file) : m_numSubMeshes(0)
+// Reading meshes is CPU-bound, so use one thread per processor, up to this many
+static const size_t MAX_LOAD_THREADS = 16;
+
+// Models with less mesh data than this load faster without extra threads
+static const size_t MIN_PARALLEL_SIZE = 4 * 1024 * 1024;
+
+// A mesh to read, from its own chunk of the model file
+struct Model::MeshJob
+{
+    Mesh*      mesh;
+    ptr<IFile> file;
+};
+
+struct Model::MeshQueue
+{
+    Model&                 model;
+    const vector<MeshJob>& jobs;
+    volatile LONG          next;
+    volatile LONG          failed;
+    exception_ptr          error;
+};
+
+DWORD WINAPI Model::ReadMeshesThread(LPVOID lpParam)
+{
+    MeshQueue& queue = *(MeshQueue*)lpParam;
+    LONG i;
+    while (queue.failed == 0 && (i = InterlockedIncrement(&queue.next) - 1) < (LONG)queue.jobs.size())
+    {
+        try
+        {
+            // Only this thread uses the job's file, so its references are safe
+            const MeshJob& job = queue.jobs[i];
+            ChunkReader reader(job.file);
+            Verify(reader.next() == 0x400);
+            queue.model.ReadMesh(reader, job.file, *job.mesh);
+
+            if (!queue.model.m_onDemand)
+            {
+                for (size_t j = 0; j < job.mesh->subMeshes.size(); j++)
+                {
+                    job.mesh->subMeshes[j].LoadVertices();
+                    job.mesh->subMeshes[j].LoadIndices();
+                }
+            }
+        }
+        catch (...)
+        {
+            // Only the first error is kept
+            if (InterlockedExchange(&queue.failed, 1) == 0)
+            {
+                queue.error = current_exception();
+            }
+        }
+    }
+    return 0;
+}
+
+// Reads the meshes, and unless loading on demand, their vertex and index data.
+// Every mesh has its own chunk, so large models read them on several threads.
+void Model::ReadMeshes(const vector<MeshJob>& jobs)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        size += jobs[i].file->size();
+    }
+
+    MeshQueue queue = {*this, jobs, 0, 0};
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    size_t nThreads = (m_onDemand || size < MIN_PARALLEL_SIZE) ? 1 : min(min((size_t)si.dwNumberOfProcessors, MAX_LOAD_THREADS), jobs.size());
+
+    vector<HANDLE> hThreads;
+    for (size_t i = 1; i < nThreads; i++)
+    {
+        DWORD  ThreadID;
+        HANDLE hThread = CreateThread(NULL, 0, ReadMeshesThread, &queue, 0, &ThreadID);
+        if (hThread == NULL)
+        {
+            // Carry on with the threads we have
+            break;
+        }
+        hThreads.push_back(hThread);
+    }
+
+    // This thread helps out as well
+    ReadMeshesThread(&queue);
+
+    if (!hThreads.empty())
+    {
+        WaitForMultipleObjects((DWORD)hThreads.size(), &hThreads[0], TRUE, INFINITE);
+        for (size_t i = 0; i < hThreads.size(); i++)
+        {
+            CloseHandle(hThreads[i]);
+        }
+    }
+
+    if (queue.failed != 0)
+    {
+        rethrow_exception(queue.error);
+    }
+
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        Mesh& mesh = *jobs[i].mesh;
+        mesh.firstSubMesh = m_numSubMeshes;
+        m_numSubMeshes   += mesh.subMeshes.size();
+
+        for (size_t j = 0; !m_onDemand && j < mesh.subMeshes.size(); j++)
+        {
+            if (mesh.subMeshes[j].m_mappedVertices == NULL && mesh.subMeshes[j].m_mappedIndices == NULL)
+            {
+                // Nothing refers to the file anymore
+                mesh.subMeshes[j].m_file = NULL;
+            }
+        }
+    }
+}
+
+Model::Model(ptr<IFile> file, bool onDemand) : m_numSubMeshes(0), m_onDemand(onDemand)
 {
     Log::WriteInfo("Loading model %ls\n", file->name().c_str() );
 
-    ChunkReader reader(file);
-    ReadSkeleton(reader);
+    // Find the top-level chunks first; each one is read from its own file
+    ChunkIndex index(file);
+    Verify(index.GetNumChunks() > 0 && index.GetChunk(0).type == 0x200);
+    {
+        ChunkReader reader(index.GetFile(0));
+        ReadSkeleton(reader);
+    }
 
     try
     {
+        // Lights are read right away, meshes are collected and read together
         vector<Attachable*> objects;
-        ChunkType type = reader.next();
-        while (type == 0x400 || type == 0x1300)
+        vector<MeshJob>     jobs;
+        long i = index.GetChunk(0).next;
+        for (; i != -1 && (index.GetChunk(i).type == 0x400 || index.GetChunk(i).type == 0x1300); i = index.GetChunk(i).next)
         {
-            if (type == 0x400) {
-                objects.push_back( ReadMesh(reader) );
-            } else {
+            if (index.GetChunk(i).type == 0x400)
+            {
+                m_meshes.push_back(NULL);
+                Mesh* mesh = m_meshes.back() = new Mesh();
+                objects.push_back(mesh);
+
+                // Sub files must be opened on this thread
+                jobs.push_back(MeshJob());
+                jobs.back().mesh = mesh;
+                jobs.back().file = index.GetFile(i);
+            }
+            else
+            {
+                ChunkReader reader(index.GetFile(i));
+                Verify(reader.next() == 0x1300);
                 objects.push_back( ReadLight(reader) );
             }
-            type = reader.next();
         }
+        ReadMeshes(jobs);
 
-        Verify(type == 0x600);
+        Verify(i != -1 && index.GetChunk(i).type == 0x600);
+        ChunkReader reader(index.GetFile(i));
+        Verify(reader.next() == 0x600);
         ReadConnections(reader, objects);
     }
     catch (...)
@@ -388,14 +920,19 @@ Model::~Model()
     Cleanup();
 }
 
-size_t Model::GetBone(std::string name) const
+size_t Model::GetBone(string_view name) const
 {
-    transform(name.begin(), name.end(), name.begin(), toupper);
-    for (size_t i = 0; i < m_bones.size(); i++)
+    if (m_boneIndex.empty())
+    {
+        return -1;
+    }
+
+    const size_t mask = m_boneIndex.size() - 1;
+    for (size_t slot = HashBoneName(name) & mask; m_boneIndex[slot] != -1; slot = (slot + 1) & mask)
     {
-        if (m_bones[i].name == name)
+        if (BoneNameEquals(m_bones[m_boneIndex[slot]].name, name))
         {
-            return i;
+            return m_boneIndex[slot];
         }
     }
     return -1;
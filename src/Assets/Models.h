@@ -2,10 +2,13 @@
 #define MODELS_H
 
 #include "Assets/ChunkFile.h"
+#include "Assets/CollisionTree.h"
+#include "Assets/SurfaceSampler.h"
 #include "General/GameTypes.h"
 #include "General/ExactTypes.h"
 #include "General/Log.h"
 #include <map>
+#include <string_view>
 
 namespace Alamo
 {
@@ -20,11 +23,26 @@ public:
         Bone*           parent;
         bool            visible;
         BillboardType   billboard;
-        Matrix          absTransform;
-        Matrix          invAbsTransform;
         Matrix          relTransform;
     };
 
+    /* The bones' transforms, flattened into separate arrays. The entries are
+     * ordered so that every parent comes before its children, so the arrays
+     * can be processed front to back. This is the file's bone order, unless
+     * the file has children before their parents.
+     */
+    struct Skeleton
+    {
+        Buffer<size_t>     bones;               // Model bone index of each entry
+        Buffer<size_t>     entries;             // Entry of each model bone
+        Buffer<size_t>     parents;             // Entry of the parent, or -1; always less than the entry itself
+        Buffer<Vector3>    scales;              // Relative transform, as scale, rotation and translation
+        Buffer<Quaternion> rotations;
+        Buffer<Vector3>    translations;
+        Buffer<Matrix>     absTransforms;
+        Buffer<Matrix>     invAbsTransforms;
+    };
+
     struct Attachable
     {
         Bone* bone;
@@ -38,10 +56,43 @@ public:
         std::string                  shader;
         std::vector<ShaderParameter> parameters;
         std::string                  vertexFormat;
-        Buffer<MASTER_VERTEX>        vertices;
-        Buffer<uint16_t>             indices;
+        size_t                       nVertices;
+        size_t                       nIndices;
         unsigned int                 nSkinBones;
         unsigned long                skin[MAX_NUM_SKIN_BONES];
+
+        /* Return the vertex and index data. For models loaded on demand, the
+         * data is read from the file on first access, so these are not safe
+         * to call from several threads at once for the same submesh.
+         * Vertex elements that are not used by the vertex format read as zero,
+         * except for the color, which reads as white.
+         */
+        VERTEX_ELEMENTS GetVertices() const;
+        const uint16_t* GetIndices()  const;
+
+        /* Makes sure the vertices keep every element that @format reads, in
+         * case it differs from vertexFormat (e.g., the shader's vertex type).
+         * Returns false if the vertices had to be reloaded with all elements.
+         */
+        bool UseVertexFormat(const std::string& format) const;
+
+    private:
+        friend class Model;
+
+        void LoadVertices() const;
+        void LoadIndices()  const;
+
+        ptr<IFile>                    m_file;           // The mesh's chunk of the model file
+        ChunkType                     m_vertexChunk;    // 0x10007 or the old format's 0x10005
+        unsigned long                 m_vertexOffset;   // Position of the vertex data in m_file
+        unsigned long                 m_indexOffset;    // Position of the index data in m_file
+        mutable unsigned long         m_elements;       // The vertex elements used by vertexFormat
+        mutable bool                  m_hasVertices;
+        mutable bool                  m_hasIndices;
+        mutable const MASTER_VERTEX*  m_mappedVertices; // Straight from the file, if possible
+        mutable const uint16_t*       m_mappedIndices;
+        mutable Buffer<char>          m_vertices;       // Otherwise, only the used elements
+        mutable Buffer<uint16_t>      m_indices;
     };
 
     struct Mesh : public Attachable
@@ -53,6 +104,24 @@ public:
         bool                 isCollidable;
         std::vector<SubMesh> subMeshes;
         size_t               nVertices;
+
+        /* Collision queries, in the mesh's own space. The collision tree is
+         * built from the submeshes' triangles on first use, so these are not
+         * safe to call from several threads at once for the same mesh.
+         */
+        const CollisionTree& GetCollisionTree() const;
+        bool IntersectRay(const Vector3& origin, const Vector3& direction, float maxDistance, CollisionTree::Hit* hit) const { return GetCollisionTree().IntersectRay(origin, direction, maxDistance, hit); }
+        void FindTriangles(const BoundingBox& box, std::vector<CollisionTree::Triangle>& triangles) const { GetCollisionTree().FindTriangles(box, triangles); }
+        bool Overlaps(const BoundingBox& box) const { return GetCollisionTree().Overlaps(box); }
+
+        /* Area-weighted sampler over the submeshes' triangles, for picking
+         * random points on the surface. Built on first use, like the collision tree.
+         */
+        const SurfaceSampler& GetSurfaceSampler() const;
+
+    private:
+        mutable ptr<CollisionTree>  m_collisionTree;
+        mutable ptr<SurfaceSampler> m_surfaceSampler;
     };
 
     struct Light : public Attachable
@@ -92,28 +161,42 @@ public:
     };
 
 private:
+    struct MeshJob;
+    struct MeshQueue;
+
     void ReadBone(ChunkReader& reader, Bone& bone);
     void ReadSkeleton(ChunkReader& reader);
-    void ReadSubMesh(ChunkReader& reader, SubMesh& mesh);
-    Mesh*  ReadMesh(ChunkReader& reader);
+    void BuildBoneIndex();
+    void BuildSkeleton();
+    void ReadSubMesh(ChunkReader& reader, ptr<IFile> file, SubMesh& mesh);
+    void   ReadMesh(ChunkReader& reader, ptr<IFile> file, Mesh& mesh);
     Light* ReadLight(ChunkReader& reader);
     unsigned long ReadDazzle(ChunkReader& reader, Dazzle& dazzle);
     void ReadConnections(ChunkReader& reader, const std::vector<Attachable*>& objects);
+    void ReadMeshes(const std::vector<MeshJob>& jobs);
     void Cleanup();
 
+    static DWORD WINAPI ReadMeshesThread(LPVOID lpParam);
+
     std::wstring        m_name;
     std::vector<Bone>   m_bones;
+    std::vector<size_t> m_boneIndex;    // Hash table of bone names; -1 is empty
+    Skeleton            m_skeleton;
     std::vector<Mesh*>  m_meshes;
     std::vector<Light*> m_lights;
     std::vector<Proxy>  m_proxies;
     std::vector<Dazzle> m_dazzles;
     size_t              m_numSubMeshes;
+    bool                m_onDemand;
 
 public:
     const std::wstring& GetName()     const { return m_name; }
     size_t        GetNumBones()       const { return m_bones.size();   }
     const Bone&   GetBone(size_t i)   const { return m_bones[i];       }
-    size_t        GetBone(std::string name) const;
+    size_t        GetBone(std::string_view name) const;    // Case-insensitive; -1 if not found
+    const Skeleton& GetSkeleton()     const { return m_skeleton; }
+    const Matrix& GetAbsTransform(size_t i)    const { return m_skeleton.absTransforms   [m_skeleton.entries[i]]; }
+    const Matrix& GetInvAbsTransform(size_t i) const { return m_skeleton.invAbsTransforms[m_skeleton.entries[i]]; }
     size_t        GetNumDazzles()     const { return m_dazzles.size();   }
     const Dazzle& GetDazzle(size_t i) const { return m_dazzles[i];       }
     size_t        GetNumMeshes()      const { return m_meshes.size();  }
@@ -125,7 +208,11 @@ public:
 
     size_t GetNumSubMeshes() const { return m_numSubMeshes; }
 
-    Model(ptr<IFile> file);
+    /* Loads the model from the file.
+     *  @onDemand: if true, submesh vertex and index data is only read when it
+     *             is first accessed, and the model keeps the file open.
+     */
+    Model(ptr<IFile> file, bool onDemand = false);
     ~Model();
 };
 
@@ -0,0 +1,100 @@
+#include "Assets/SurfaceSampler.h"
+#include <math.h>
+using namespace std;
+
+namespace Alamo
+{
+
+// Turns the top 24 bits of a random number into a float in [0,1)
+static float ToUnitFloat(uint32_t random)
+{
+    return (random >> 8) * (1.0f / 16777216.0f);
+}
+
+void SurfaceSampler::AddTriangle(uint32_t subMesh, const uint16_t* indices, const Vector3& v1, const Vector3& v2, const Vector3& v3)
+{
+    Entry entry;
+    entry.probability = 1.0f;
+    entry.alias       = (uint32_t)m_triangles.size();
+    entry.subMesh     = subMesh;
+    entry.v[0]        = indices[0];
+    entry.v[1]        = indices[1];
+    entry.v[2]        = indices[2];
+    m_triangles.push_back(entry);
+    m_areas.push_back((v2 - v1).cross(v3 - v1).length() * 0.5f);
+}
+
+void SurfaceSampler::Build()
+{
+    const size_t n = m_triangles.size();
+
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        total += m_areas[i];
+    }
+
+    // Scale the weights so they average to one. A mesh without any area
+    // still gets an even spread over its triangles.
+    vector<double> weights(n, 1.0);
+    if (total > 0.0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            weights[i] = m_areas[i] * n / total;
+        }
+    }
+
+    // Pair up every under-full slot with an over-full triangle that tops it up
+    vector<uint32_t> small, large;
+    for (size_t i = 0; i < n; i++)
+    {
+        (weights[i] < 1.0 ? small : large).push_back((uint32_t)i);
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        uint32_t s = small.back(); small.pop_back();
+        uint32_t l = large.back(); large.pop_back();
+
+        m_triangles[s].probability = (float)weights[s];
+        m_triangles[s].alias       = l;
+
+        weights[l] = (weights[l] + weights[s]) - 1.0;
+        (weights[l] < 1.0 ? small : large).push_back(l);
+    }
+
+    // Whatever is left is full up to rounding errors
+    for (size_t i = 0; i < small.size(); i++) m_triangles[small[i]].probability = 1.0f;
+    for (size_t i = 0; i < large.size(); i++) m_triangles[large[i]].probability = 1.0f;
+
+    vector<float>().swap(m_areas);
+}
+
+bool SurfaceSampler::GetSample(uint64_t random1, uint64_t random2, Sample* sample) const
+{
+    if (m_triangles.empty())
+    {
+        return false;
+    }
+
+    // High bits pick the slot, low bits pick between it and its alias
+    const uint32_t slot  = (uint32_t)(((random1 >> 32) * m_triangles.size()) >> 32);
+    const Entry&   entry = m_triangles[slot];
+    const Entry&   found = (ToUnitFloat((uint32_t)random1) < entry.probability) ? entry : m_triangles[entry.alias];
+
+    // Uniform barycentric coordinates
+    const float s = sqrtf(ToUnitFloat((uint32_t)(random2 >> 32)));
+    const float t = ToUnitFloat((uint32_t)random2);
+
+    sample->subMesh = found.subMesh;
+    sample->v[0]    = found.v[0];
+    sample->v[1]    = found.v[1];
+    sample->v[2]    = found.v[2];
+    sample->w[0]    = 1.0f - s;
+    sample->w[1]    = s * (1.0f - t);
+    sample->w[2]    = s * t;
+    return true;
+}
+
+}
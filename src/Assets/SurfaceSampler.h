@@ -0,0 +1,57 @@
+#ifndef SURFACESAMPLER_H
+#define SURFACESAMPLER_H
+
+#include "General/GameTypes.h"
+#include "General/Objects.h"
+#include "General/ExactTypes.h"
+#include <vector>
+
+namespace Alamo
+{
+
+/*
+ * Picks points uniformly over the surface of a mesh. The triangles are kept
+ * in an alias table (Vose's method) weighted by their area, so picking one
+ * takes constant time regardless of the number of triangles.
+ */
+class SurfaceSampler : public IObject
+{
+public:
+    // A point on the surface: a triangle and the barycentric weights of its vertices
+    struct Sample
+    {
+        uint32_t subMesh;
+        uint16_t v[3];      // Vertex indices in the submesh
+        float    w[3];
+    };
+
+    /* Adds a triangle with the given vertex positions. Call Build() after adding all triangles. */
+    void AddTriangle(uint32_t subMesh, const uint16_t* indices, const Vector3& v1, const Vector3& v2, const Vector3& v3);
+
+    /* Builds the alias table over the added triangles. */
+    void Build();
+
+    /* Picks a point from two uniformly distributed 64-bit random numbers; the
+     * first selects the triangle, the second the position on it.
+     * Returns false if the mesh has no triangles.
+     */
+    bool GetSample(uint64_t random1, uint64_t random2, Sample* sample) const;
+
+    size_t GetNumTriangles() const { return m_triangles.size(); }
+
+private:
+    struct Entry
+    {
+        float    probability;   // Chance of keeping this slot's own triangle
+        uint32_t alias;         // Triangle to use otherwise
+        uint32_t subMesh;
+        uint16_t v[3];
+    };
+
+    std::vector<Entry> m_triangles;
+    std::vector<float> m_areas;     // Only used while building
+};
+
+}
+
+#endif
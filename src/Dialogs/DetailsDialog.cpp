@@ -154,7 +154,7 @@ static wstring val2str(const DWORD* val)
     return ss.str();
 }
 
-static HWND ShowBone(HWND hWnd, const Model::Bone& bone)
+static HWND ShowBone(HWND hWnd, const Model& model, const Model::Bone& bone)
 {
     HWND hContainer = GetDlgItem(hWnd, IDC_CONTAINER);
     HWND hDlg = CreateDialogParam(NULL, MAKEINTRESOURCE(IDD_DETAILS_BONE), hContainer, StaticDialogProc, NULL);
@@ -168,7 +168,7 @@ static HWND ShowBone(HWND hWnd, const Model::Bone& bone)
         rtr[i] << fixed << "[" << row.x << ", " << row.y << ", " << row.z << ", " << row.w << "]";
         
         atr[i].precision(3);
-        row = bone.absTransform.row(i);
+        row = model.GetAbsTransform(bone.index).row(i);
         atr[i] << fixed << "[" << row.x << ", " << row.y << ", " << row.z << ", " << row.w << "]";
     }
 
@@ -292,22 +292,24 @@ static HWND ShowVertices(HWND hWnd, const Model::SubMesh& submesh)
     // Fill the list
     LV_ITEM item;
     item.mask = LVIF_TEXT;
-    for (item.iItem = 0; item.iItem < (int)submesh.vertices.size(); item.iItem++)
+    const VERTEX_ELEMENTS v = submesh.GetVertices();
+    for (item.iItem = 0; item.iItem < (int)submesh.nVertices; item.iItem++)
     {
-        const MASTER_VERTEX& v = submesh.vertices[item.iItem];
+        const int i = item.iItem;
+        const DWORD indices[4] = {v.BoneIndices[0][i], v.BoneIndices[1][i], v.BoneIndices[2][i], v.BoneIndices[3][i]};
         wstring temp;
         temp = val2str(item.iItem); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 0; ListView_InsertItem(hList, &item);
-        temp = val2str(v.Position); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 1; ListView_SetItem(hList, &item);
-        temp = val2str(v.Normal);   item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 2; ListView_SetItem(hList, &item);
-        temp = val2str(v.TexCoord[0]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 3; ListView_SetItem(hList, &item);
-        temp = val2str(v.TexCoord[1]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 4; ListView_SetItem(hList, &item);
-        temp = val2str(v.TexCoord[2]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 5; ListView_SetItem(hList, &item);
-        temp = val2str(v.TexCoord[3]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 6; ListView_SetItem(hList, &item);
-        temp = val2str(v.Tangent);  item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 7; ListView_SetItem(hList, &item);
-        temp = val2str(v.Binormal); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 8; ListView_SetItem(hList, &item);
-        temp = val2str(Vector4(v.Color));       item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 9; ListView_SetItem(hList, &item);
-        temp = val2str(v.BoneIndices);          item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 10; ListView_SetItem(hList, &item);
-        temp = val2str(Vector4(v.BoneWeights)); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 11; ListView_SetItem(hList, &item);
+        temp = val2str(v.Position[i]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 1; ListView_SetItem(hList, &item);
+        temp = val2str(v.Normal[i]);   item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 2; ListView_SetItem(hList, &item);
+        temp = val2str(v.TexCoord[0][i]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 3; ListView_SetItem(hList, &item);
+        temp = val2str(v.TexCoord[1][i]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 4; ListView_SetItem(hList, &item);
+        temp = val2str(v.TexCoord[2][i]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 5; ListView_SetItem(hList, &item);
+        temp = val2str(v.TexCoord[3][i]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 6; ListView_SetItem(hList, &item);
+        temp = val2str(v.Tangent[i]);  item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 7; ListView_SetItem(hList, &item);
+        temp = val2str(v.Binormal[i]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 8; ListView_SetItem(hList, &item);
+        temp = val2str(Vector4(v.Color[i])); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 9; ListView_SetItem(hList, &item);
+        temp = val2str(indices);             item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 10; ListView_SetItem(hList, &item);
+        temp = val2str(Vector4(v.BoneWeights[0][i], v.BoneWeights[1][i], v.BoneWeights[2][i], v.BoneWeights[3][i])); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 11; ListView_SetItem(hList, &item);
     }
     SetCursor(hOldCursor);
 
@@ -382,13 +384,14 @@ static HWND ShowFaces(HWND hWnd, const Model::SubMesh& submesh)
     // Fill the list
     LV_ITEM item;
     item.mask = LVIF_TEXT;
-    for (item.iItem = 0; item.iItem < (int)submesh.indices.size() / 3; item.iItem++)
+    const uint16_t* indices = submesh.GetIndices();
+    for (item.iItem = 0; item.iItem < (int)submesh.nIndices / 3; item.iItem++)
     {
         wstring temp;
         temp = val2str(item.iItem);                        item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 0; ListView_InsertItem(hList, &item);
-        temp = val2str(submesh.indices[3*item.iItem + 0]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 1; ListView_SetItem(hList, &item);
-        temp = val2str(submesh.indices[3*item.iItem + 1]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 2; ListView_SetItem(hList, &item);
-        temp = val2str(submesh.indices[3*item.iItem + 2]); item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 3; ListView_SetItem(hList, &item);
+        temp = val2str(indices[3*item.iItem + 0]);         item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 1; ListView_SetItem(hList, &item);
+        temp = val2str(indices[3*item.iItem + 1]);         item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 2; ListView_SetItem(hList, &item);
+        temp = val2str(indices[3*item.iItem + 2]);         item.pszText = (LPWSTR)temp.c_str(); item.iSubItem = 3; ListView_SetItem(hList, &item);
     }
     SetCursor(hOldCursor);
 
@@ -496,7 +499,7 @@ static HWND ShowModelItem(HWND hWnd, const Model& model, const ModelPath& path)
     switch (path.GetType())
     {
     case ModelPath::BONE:
-        return ShowBone(hWnd, model.GetBone(path.GetBone()));
+        return ShowBone(hWnd, model, model.GetBone(path.GetBone()));
 
     case ModelPath::PROXY:
         return ShowProxy(hWnd, model.GetProxy(path.GetProxy()));
@@ -550,12 +553,12 @@ static void FillSubMesh(HWND hTree, HTREEITEM hParent, const Model::SubMesh& sub
         TreeView_InsertItem(hTree, &tvis);
     }
 
-    wstring temp = LoadString(IDS_DETAILS_VERTICES, submesh.vertices.size());
+    wstring temp = LoadString(IDS_DETAILS_VERTICES, submesh.nVertices);
     tvis.item.pszText   = (LPWSTR)temp.c_str();
     tvis.item.lParam    = ModelPath(parent).SetMeshObjectType(ModelPath::VERTICES).GetValue();
     TreeView_InsertItem(hTree, &tvis);
 
-    temp = LoadString(IDS_DETAILS_FACES, submesh.indices.size() / 3);
+    temp = LoadString(IDS_DETAILS_FACES, submesh.nIndices / 3);
     tvis.item.pszText   = (LPWSTR)temp.c_str();
     tvis.item.lParam    = ModelPath(parent).SetMeshObjectType(ModelPath::FACES).GetValue();
     TreeView_InsertItem(hTree, &tvis);
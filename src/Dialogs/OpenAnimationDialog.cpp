@@ -14,15 +14,8 @@ static bool AnimationFilter(const string& name, ptr<IFile> f, void* param)
     if (ofs != string::npos && Uppercase(name.substr(ofs + 1)) == "ALA")
     {
         // Check compatability
-        try
-        {
-            const Model* model = (const Model*)param;
-            ptr<Animation> anim = new Animation(f, *model, true);
-            return true;
-        }
-        catch (...)
-        {
-        }
+        const Model* model = (const Model*)param;
+        return Animation::Probe(*f, *model) == Animation::PROBE_COMPATIBLE;
     }
     return false;
 }
@@ -57,10 +50,11 @@ ptr<Animation> Dialogs::ShowOpenAnimationDialog(HWND hWndParent, ptr<Model> mode
 		{
             *filename = filebuf;
 			wstring ext = Uppercase(&filebuf[ofn.nFileExtension]);
-			ptr<IFile> file = new PhysicalFile(filebuf);
+			ptr<IFile> file;
 			if (ext == L"MEG")
 			{
 				// Load it through a MegaFile
+				file = OpenMappedFile(filebuf);
 				ptr<MegaFile> meg = new MegaFile( file );
                 int index = Dialogs::ShowSelectSubFileDialog(hWndParent, meg, AnimationFilter, (Model*)model);
                 if (index >= 0)
@@ -69,6 +63,10 @@ ptr<Animation> Dialogs::ShowOpenAnimationDialog(HWND hWndParent, ptr<Model> mode
                     *filename += L"|" + AnsiToWide(meg->GetFilename(index));
                 }
 			}
+			else
+			{
+				file = new PhysicalFile(filebuf);
+			}
 			
             if (file != NULL)
 			{
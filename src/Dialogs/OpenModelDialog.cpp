@@ -42,10 +42,11 @@ ptr<Model> Dialogs::ShowOpenModelDialog(HWND hWndParent, wstring* filename, ptr<
 		{
             *filename = filebuf;
 			wstring ext = Uppercase(&filebuf[ofn.nFileExtension]);
-			ptr<IFile> file = new PhysicalFile(filebuf);
+			ptr<IFile> file;
 			if (ext == L"MEG")
 			{
 				// Load it through a MegaFile
+				file = OpenMappedFile(filebuf);
 				meg = new MegaFile( file );
                 int index = Dialogs::ShowSelectSubFileDialog(hWndParent, meg, ModelFilter, NULL);
                 if (index >= 0)
@@ -54,6 +55,10 @@ ptr<Model> Dialogs::ShowOpenModelDialog(HWND hWndParent, wstring* filename, ptr<
                     *filename += L"|" + AnsiToWide(meg->GetFilename(index));
                 }
 			}
+			else
+			{
+				file = new PhysicalFile(filebuf);
+			}
 			
             if (file != NULL)
 			{
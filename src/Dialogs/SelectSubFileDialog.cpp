@@ -25,7 +25,7 @@ INT_PTR CALLBACK SelectFileDlgProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
         	SELECTFILEPARAM* sfp = (SELECTFILEPARAM*)lParam;
 			for (unsigned int i = 0; i < sfp->megaFile->GetNumFiles(); i++)
 			{
-                const string& name = sfp->megaFile->GetFilename(i);
+                string name = sfp->megaFile->GetFilename(i);
 				ptr<IFile> f = sfp->megaFile->GetFile(i);
                 if (sfp->callback == NULL || sfp->callback(name, f, sfp->userData))
 			    {
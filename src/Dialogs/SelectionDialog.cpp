@@ -2,7 +2,9 @@
 #include "General\Exceptions.h"
 #include "General\WinUtils.h"
 #include "General\Utils.h"
+#include "Assets\AnimationCatalog.h"
 #include <commctrl.h>
+#include <algorithm>
 #include "resource.h"
 using namespace Alamo;
 using namespace std;
@@ -23,6 +25,7 @@ struct SELECTION_INFO
     ISelectionCallback*     callback;
     IRenderObject*          object;
     vector<ANIMATION_INFO>  animations;
+    AnimationCatalog        catalog;
     int                     maxAlt;
     int                     maxLod;
 };
@@ -143,7 +146,19 @@ static void PlayAnimation(SELECTION_INFO* info, int index, bool loop)
         ANIMATION_INFO* pai = &info->animations[index];
         if (pai->animation == NULL)
         {
-            pai->animation = new Animation(pai->file, *info->object->GetTemplate()->GetModel());
+            try
+            {
+                // Animations stay cached for as long as the list is open, so keep them compressed
+                pai->animation = new Animation(pai->file, *info->object->GetTemplate()->GetModel(), false, true);
+            }
+            catch (wexception&)
+            {
+                // The list only checked the bones at the start of the file
+                pai->file->seek(0);
+                wstring error = LoadString(IDS_ERR_UNABLE_TO_OPEN_ANIMATION);
+                MessageBox(NULL, error.c_str(), NULL, MB_OK | MB_ICONHAND );
+                return;
+            }
         }
         info->callback->OnAnimationSelected(pai->animation, pai->filename, loop);
     }
@@ -494,8 +509,43 @@ static INT_PTR CALLBACK SelectionDialogProc(HWND hWnd, UINT uMsg, WPARAM wParam,
     return FALSE;
 }
 
-static void LoadAnimationList(vector<ANIMATION_INFO>& animations, const Model& model, const MegaFile* megaFile, wstring wModelFilename)
+// Adds the candidate animations that fit the model to the list as they are checked
+class AnimationListFiller : public AnimationCatalog::IListener
+{
+    const vector<ANIMATION_INFO>& m_candidates;
+    vector<ANIMATION_INFO>&       m_animations;
+    HWND                          m_hList;
+    vector<size_t>                m_rows;   // Candidate index of every row, sorted
+
+    void OnAnimationChecked(size_t index, bool compatible)
+    {
+        if (compatible)
+        {
+            // Keep the rows in the candidates' order; lParam stays the index in m_animations
+            vector<size_t>::iterator row = lower_bound(m_rows.begin(), m_rows.end(), index);
+            LV_ITEM item;
+            item.mask     = LVIF_TEXT | LVIF_PARAM;
+            item.pszText  = (LPWSTR)m_candidates[index].name.c_str();
+            item.lParam   = m_animations.size();
+            item.iItem    = (int)(row - m_rows.begin());
+            item.iSubItem = 0;
+            m_rows.insert(row, index);
+            m_animations.push_back(m_candidates[index]);
+            ListView_InsertItem(m_hList, &item);
+
+            // Show it now; the remaining files are still being checked on this thread
+            UpdateWindow(m_hList);
+        }
+    }
+
+public:
+    AnimationListFiller(const vector<ANIMATION_INFO>& candidates, vector<ANIMATION_INFO>& animations, HWND hList)
+        : m_candidates(candidates), m_animations(animations), m_hList(hList) {}
+};
+
+static void LoadAnimationList(HWND hList, vector<ANIMATION_INFO>& animations, AnimationCatalog& catalog, const Model& model, const MegaFile* megaFile, wstring wModelFilename)
 {
+    vector<ANIMATION_INFO> candidates;
     if (megaFile != NULL)
     {
         // Read them from the mega file
@@ -530,24 +580,12 @@ static void LoadAnimationList(vector<ANIMATION_INFO>& animations, const Model& m
                     // Must have same base as model file
                     if (name.find(modelFilename) == 0)
                     {
-                        try
-                        {
-                            // Load file to check only
-                            ANIMATION_INFO info;
-                            info.filename  = AnsiToWide(filename);
-                            info.name      = AnsiToWide(name.substr(modelFilename.length()));
-                            info.file      = megaFile->GetFile(i);
-                            info.animation = NULL;
-
-                            ptr<Animation> anim = new Animation(info.file, model, true);
-                            
-                            // Animation matches, reset file and add it
-                            info.file->seek(0);
-                            animations.push_back(info);
-                        }
-                        catch (wexception&)
-                        {
-                        }
+                        ANIMATION_INFO info;
+                        info.filename  = AnsiToWide(filename);
+                        info.name      = AnsiToWide(name.substr(modelFilename.length()));
+                        info.file      = megaFile->GetFile(i);
+                        info.animation = NULL;
+                        candidates.push_back(info);
                     }
                 }
             }
@@ -578,19 +616,13 @@ static void LoadAnimationList(vector<ANIMATION_INFO>& animations, const Model& m
             {
                 try
                 {
-                    // Load file to check only
                     ANIMATION_INFO info;
                     info.filename  = wfd.cFileName;
                     info.name      = info.filename.substr(wModelFilename.length() + 1);
                     info.name      = info.name.substr(0, info.name.length() - 4);    // Strip extension
                     info.file      = new PhysicalFile(dir + wfd.cFileName);
                     info.animation = NULL;
-
-                    ptr<Animation> anim = new Animation(info.file, model, true);
-                    
-                    // Animation matches, reset file and add it
-                    info.file->seek(0);
-                    animations.push_back(info);
+                    candidates.push_back(info);
                 }
                 catch (wexception&)
                 {
@@ -600,6 +632,17 @@ static void LoadAnimationList(vector<ANIMATION_INFO>& animations, const Model& m
             FindClose(hFind);
         }
     }
+
+    // Check them all at once, and list the ones that fit as they come in
+    vector< ptr<IFile> > files(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        files[i] = candidates[i].file;
+    }
+
+    animations.reserve(candidates.size());
+    AnimationListFiller listener(candidates, animations, hList);
+    catalog.Check(files, model, listener);
 }
 
 void Selection_ResetObject(HWND hWnd, IRenderObject* object)
@@ -728,17 +771,7 @@ void Selection_SetObject(HWND hWnd, IRenderObject* object, ptr<MegaFile> megaFil
         }
 
         // Fill animation list
-        LoadAnimationList(info->animations, *model, megaFile, filename);
-        for (size_t i = 0; i < info->animations.size(); i++)
-        {
-            LV_ITEM item;
-            item.mask     = LVIF_TEXT | LVIF_PARAM;
-            item.pszText  = (LPWSTR)info->animations[i].name.c_str();
-            item.lParam   = i;
-            item.iItem    = (int)i;
-            item.iSubItem = 0;
-            ListView_InsertItem(hAnimList, &item);
-        }
+        LoadAnimationList(hAnimList, info->animations, info->catalog, *model, megaFile, filename);
 
         info->object = object;
 
@@ -3,7 +3,7 @@
 
 #include <stdint.h>
 
-#ifdef _M_IX86
+#if defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM64)
 #define LITTLE_ENDIAN
 #else
 #define BIG_ENDIAN
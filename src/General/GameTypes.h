@@ -140,6 +140,33 @@ struct MASTER_VERTEX
 };
 #pragma pack()
 
+// Read-only view of one element of a list of vertices, wherever and however
+// the vertices are stored. A stride of zero repeats a single default value.
+template <typename T>
+class VertexElement
+{
+    const char* m_data;
+    size_t      m_stride;
+
+public:
+    const T& operator[](size_t i) const { return *(const T*)(m_data + i * m_stride); }
+
+    VertexElement(const void* data = NULL, size_t stride = sizeof(T)) : m_data((const char*)data), m_stride(stride) {}
+};
+
+// The elements of MASTER_VERTEX, as separate views
+struct VERTEX_ELEMENTS
+{
+    VertexElement<Vector3> Position;
+    VertexElement<Vector3> Normal;
+    VertexElement<Vector2> TexCoord[4];
+    VertexElement<Vector3> Tangent;
+    VertexElement<Vector3> Binormal;
+    VertexElement<Color>   Color;
+    VertexElement<DWORD>   BoneIndices[4];
+    VertexElement<float>   BoneWeights[4];
+};
+
 enum LightFieldSourceType {
     LFT_POINT = 0,
     LFT_HCONE,
@@ -0,0 +1,277 @@
+#include "General/PoseMath.h"
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define POSEMATH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Alamo
+{
+
+//
+// Slerp is approximated with the series from David Eberly's "A Fast and
+// Accurate Algorithm for Computing SLERP". It needs no acos or sin, so four
+// quaternions can be done at once. The last term is scaled by mu, which was
+// fitted to keep the error of the weights around 1e-6 over the whole range.
+//
+static const int   SLERP_TERMS = 12;
+static const float SLERP_MU    = 1.89375f;
+static const float SlerpU[SLERP_TERMS] = {
+    1.0f/(1*3), 1.0f/(2*5), 1.0f/(3*7),  1.0f/(4*9),   1.0f/(5*11),  1.0f/(6*13),
+    1.0f/(7*15), 1.0f/(8*17), 1.0f/(9*19), 1.0f/(10*21), 1.0f/(11*23), SLERP_MU/(12*25)
+};
+static const float SlerpV[SLERP_TERMS] = {
+    1.0f/3, 2.0f/5,  3.0f/7,  4.0f/9,   5.0f/11,  6.0f/13,
+    7.0f/15, 8.0f/17, 9.0f/19, 10.0f/21, 11.0f/23, SLERP_MU*12/25
+};
+
+// Per-call constants for interpolating by s
+struct SlerpFactors
+{
+    float s, d;                 // Weights of the target and source
+    float kT[SLERP_TERMS];      // Polynomial terms, before multiplying by cos(angle) - 1
+    float kD[SLERP_TERMS];
+
+    SlerpFactors(float s_) : s(s_), d(1 - s_)
+    {
+        for (int i = 0; i < SLERP_TERMS; i++)
+        {
+            kT[i] = SlerpU[i] * s * s - SlerpV[i];
+            kD[i] = SlerpU[i] * d * d - SlerpV[i];
+        }
+    }
+};
+
+static void InterpolateBone(const PoseBuffer& from, const PoseBuffer& to, size_t i, const SlerpFactors& f, PoseBuffer& out, bool exact)
+{
+    for (int j = 0; j < 3; j++)
+    {
+        out.scale[j][i]       = from.scale[j][i]       + (to.scale[j][i]       - from.scale[j][i])       * f.s;
+        out.translation[j][i] = from.translation[j][i] + (to.translation[j][i] - from.translation[j][i]) * f.s;
+    }
+
+    float a[4], b[4], dot = 0;
+    for (int j = 0; j < 4; j++)
+    {
+        a[j] = from.rotation[j][i];
+        b[j] = to.rotation[j][i];
+        dot += a[j] * b[j];
+    }
+
+    // Take the shortest arc
+    const float sign = (dot < 0) ? -1.0f : 1.0f;
+    dot *= sign;
+
+    float wa, wb;
+    if (exact)
+    {
+        const float xm1 = dot - 1;
+        float cT = 1, cD = 1;
+        for (int k = SLERP_TERMS - 1; k >= 0; k--)
+        {
+            cT = 1 + f.kT[k] * xm1 * cT;
+            cD = 1 + f.kD[k] * xm1 * cD;
+        }
+        wa = cD * f.d;
+        wb = cT * f.s * sign;
+    }
+    else
+    {
+        float r[4], len = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            r[j] = a[j] * f.d + b[j] * f.s * sign;
+            len += r[j] * r[j];
+        }
+        len = 1.0f / sqrtf(len);
+        wa  = f.d * len;
+        wb  = f.s * sign * len;
+    }
+
+    for (int j = 0; j < 4; j++)
+    {
+        out.rotation[j][i] = a[j] * wa + b[j] * wb;
+    }
+}
+
+static void ComposeBone(const PoseBuffer& pose, size_t i, Matrix& m)
+{
+    const float x = pose.rotation[0][i], y = pose.rotation[1][i], z = pose.rotation[2][i], w = pose.rotation[3][i];
+    const float sx = pose.scale[0][i], sy = pose.scale[1][i], sz = pose.scale[2][i];
+
+    m._11 = sx * (1 - 2 * (y*y + z*z)); m._12 = sx * 2 * (x*y + z*w);       m._13 = sx * 2 * (x*z - y*w);       m._14 = 0;
+    m._21 = sy * 2 * (x*y - z*w);       m._22 = sy * (1 - 2 * (x*x + z*z)); m._23 = sy * 2 * (y*z + x*w);       m._24 = 0;
+    m._31 = sz * 2 * (x*z + y*w);       m._32 = sz * 2 * (y*z - x*w);       m._33 = sz * (1 - 2 * (x*x + y*y)); m._34 = 0;
+    m._41 = pose.translation[0][i];     m._42 = pose.translation[1][i];     m._43 = pose.translation[2][i];     m._44 = 1;
+}
+
+#ifdef POSEMATH_SSE2
+// Handles four bones from i on
+static void InterpolateBones(const PoseBuffer& from, const PoseBuffer& to, size_t i, const SlerpFactors& f, PoseBuffer& out, bool exact)
+{
+    const __m128 s = _mm_set1_ps(f.s);
+    const __m128 d = _mm_set1_ps(f.d);
+    for (int j = 0; j < 3; j++)
+    {
+        __m128 s0 = _mm_loadu_ps(&from.scale[j][i]),       s1 = _mm_loadu_ps(&to.scale[j][i]);
+        __m128 t0 = _mm_loadu_ps(&from.translation[j][i]), t1 = _mm_loadu_ps(&to.translation[j][i]);
+        _mm_storeu_ps(&out.scale[j][i],       _mm_add_ps(s0, _mm_mul_ps(_mm_sub_ps(s1, s0), s)));
+        _mm_storeu_ps(&out.translation[j][i], _mm_add_ps(t0, _mm_mul_ps(_mm_sub_ps(t1, t0), s)));
+    }
+
+    __m128 a[4], b[4], dot = _mm_setzero_ps();
+    for (int j = 0; j < 4; j++)
+    {
+        a[j] = _mm_loadu_ps(&from.rotation[j][i]);
+        b[j] = _mm_loadu_ps(&to.rotation[j][i]);
+        dot  = _mm_add_ps(dot, _mm_mul_ps(a[j], b[j]));
+    }
+
+    // Take the shortest arc by flipping the sign of the target weight
+    const __m128 one  = _mm_set1_ps(1.0f);
+    const __m128 sign = _mm_and_ps(dot, _mm_set1_ps(-0.0f));
+    dot = _mm_xor_ps(dot, sign);
+
+    __m128 wa, wb;
+    if (exact)
+    {
+        const __m128 xm1 = _mm_sub_ps(dot, one);
+        __m128 cT = one, cD = one;
+        for (int k = SLERP_TERMS - 1; k >= 0; k--)
+        {
+            cT = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(f.kT[k]), xm1), cT));
+            cD = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(f.kD[k]), xm1), cD));
+        }
+        wa = _mm_mul_ps(cD, d);
+        wb = _mm_xor_ps(_mm_mul_ps(cT, s), sign);
+    }
+    else
+    {
+        const __m128 sb = _mm_xor_ps(s, sign);
+        __m128 len = _mm_setzero_ps();
+        for (int j = 0; j < 4; j++)
+        {
+            __m128 r = _mm_add_ps(_mm_mul_ps(a[j], d), _mm_mul_ps(b[j], sb));
+            len = _mm_add_ps(len, _mm_mul_ps(r, r));
+        }
+        len = _mm_div_ps(one, _mm_sqrt_ps(len));
+        wa  = _mm_mul_ps(d,  len);
+        wb  = _mm_mul_ps(sb, len);
+    }
+
+    for (int j = 0; j < 4; j++)
+    {
+        _mm_storeu_ps(&out.rotation[j][i], _mm_add_ps(_mm_mul_ps(a[j], wa), _mm_mul_ps(b[j], wb)));
+    }
+}
+
+// Handles four bones from i on
+static void ComposeBones(const PoseBuffer& pose, size_t i, Matrix* m)
+{
+    const __m128 x = _mm_loadu_ps(&pose.rotation[0][i]);
+    const __m128 y = _mm_loadu_ps(&pose.rotation[1][i]);
+    const __m128 z = _mm_loadu_ps(&pose.rotation[2][i]);
+    const __m128 w = _mm_loadu_ps(&pose.rotation[3][i]);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    const __m128 x2 = _mm_mul_ps(x, two), y2 = _mm_mul_ps(y, two), z2 = _mm_mul_ps(z, two);
+    const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+    const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+    const __m128 xw = _mm_mul_ps(w, x2), yw = _mm_mul_ps(w, y2), zw = _mm_mul_ps(w, z2);
+
+    // One register per matrix element, for four bones
+    __m128 rows[4][4];
+    const __m128 sx = _mm_loadu_ps(&pose.scale[0][i]);
+    const __m128 sy = _mm_loadu_ps(&pose.scale[1][i]);
+    const __m128 sz = _mm_loadu_ps(&pose.scale[2][i]);
+    rows[0][0] = _mm_mul_ps(sx, _mm_sub_ps(one, _mm_add_ps(yy, zz)));
+    rows[0][1] = _mm_mul_ps(sx, _mm_add_ps(xy, zw));
+    rows[0][2] = _mm_mul_ps(sx, _mm_sub_ps(xz, yw));
+    rows[0][3] = _mm_setzero_ps();
+    rows[1][0] = _mm_mul_ps(sy, _mm_sub_ps(xy, zw));
+    rows[1][1] = _mm_mul_ps(sy, _mm_sub_ps(one, _mm_add_ps(xx, zz)));
+    rows[1][2] = _mm_mul_ps(sy, _mm_add_ps(yz, xw));
+    rows[1][3] = _mm_setzero_ps();
+    rows[2][0] = _mm_mul_ps(sz, _mm_add_ps(xz, yw));
+    rows[2][1] = _mm_mul_ps(sz, _mm_sub_ps(yz, xw));
+    rows[2][2] = _mm_mul_ps(sz, _mm_sub_ps(one, _mm_add_ps(xx, yy)));
+    rows[2][3] = _mm_setzero_ps();
+    rows[3][0] = _mm_loadu_ps(&pose.translation[0][i]);
+    rows[3][1] = _mm_loadu_ps(&pose.translation[1][i]);
+    rows[3][2] = _mm_loadu_ps(&pose.translation[2][i]);
+    rows[3][3] = one;
+
+    // Transpose each row from per-element to per-bone and store it
+    for (int r = 0; r < 4; r++)
+    {
+        _MM_TRANSPOSE4_PS(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+        for (int k = 0; k < 4; k++)
+        {
+            _mm_storeu_ps(m[k].m[r], rows[r][k]);
+        }
+    }
+}
+#endif
+
+void InterpolatePoses(const PoseBuffer& from, const PoseBuffer& to, float s, PoseBuffer& out, bool exact)
+{
+    const SlerpFactors factors(s);
+    const size_t       n = out.size();
+    size_t             i = 0;
+#ifdef POSEMATH_SSE2
+    for (; i + 4 <= n; i += 4)
+    {
+        InterpolateBones(from, to, i, factors, out, exact);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        InterpolateBone(from, to, i, factors, out, exact);
+    }
+}
+
+void ComposePose(const PoseBuffer& pose, Matrix* out)
+{
+    const size_t n = pose.size();
+    size_t       i = 0;
+#ifdef POSEMATH_SSE2
+    for (; i + 4 <= n; i += 4)
+    {
+        ComposeBones(pose, i, &out[i]);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        ComposeBone(pose, i, out[i]);
+    }
+}
+
+//
+// PoseBuffer
+//
+void PoseBuffer::resize(size_t size)
+{
+    m_data.resize(size * 10);
+    m_size = size;
+
+    float* data = m_data;
+    for (int i = 0; i < 3; i++) scale[i]       = data + (0 + i) * size;
+    for (int i = 0; i < 4; i++) rotation[i]    = data + (3 + i) * size;
+    for (int i = 0; i < 3; i++) translation[i] = data + (7 + i) * size;
+}
+
+void PoseBuffer::set(size_t i, const Vector3& s, const Quaternion& r, const Vector3& t)
+{
+    scale[0][i] = s.x; scale[1][i] = s.y; scale[2][i] = s.z;
+    rotation[0][i] = r.x; rotation[1][i] = r.y; rotation[2][i] = r.z; rotation[3][i] = r.w;
+    translation[0][i] = t.x; translation[1][i] = t.y; translation[2][i] = t.z;
+}
+
+PoseBuffer::PoseBuffer()
+{
+    resize(0);
+}
+
+}
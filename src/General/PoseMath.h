@@ -0,0 +1,54 @@
+#ifndef POSEMATH_H
+#define POSEMATH_H
+
+#include "General/3DTypes.h"
+#include "General/Objects.h"
+
+/*
+ * Batched transform math for animation sampling. Poses are stored with one
+ * array per component, so that these functions can work on four bones per
+ * instruction with SSE2. Targets without SSE2 use the equivalent scalar code.
+ */
+namespace Alamo
+{
+
+// The scale, rotation and translation of a number of bones
+class PoseBuffer
+{
+    Buffer<float> m_data;
+    size_t        m_size;
+
+    // Not copyable; the component pointers point into m_data
+    PoseBuffer(const PoseBuffer&);
+    PoseBuffer& operator=(const PoseBuffer&);
+
+public:
+    float* scale[3];
+    float* rotation[4];
+    float* translation[3];
+
+    size_t size() const { return m_size; }
+    void   resize(size_t size);
+
+    /* Sets or gets the transform of a single bone */
+    void       set(size_t i, const Vector3& s, const Quaternion& r, const Vector3& t);
+    Vector3    getScale      (size_t i) const { return Vector3(scale[0][i], scale[1][i], scale[2][i]); }
+    Quaternion getRotation   (size_t i) const { return Quaternion(rotation[0][i], rotation[1][i], rotation[2][i], rotation[3][i]); }
+    Vector3    getTranslation(size_t i) const { return Vector3(translation[0][i], translation[1][i], translation[2][i]); }
+
+    PoseBuffer();
+};
+
+/* Interpolates every bone from @from to @to by @s into @out, which may be
+ * either of the two. Scale and translation are interpolated linearly.
+ * Rotations take the shortest arc; with @exact they are spherically
+ * interpolated (to about 1e-6), otherwise they are linearly interpolated
+ * and normalized, which is cheaper but does not turn at a constant rate.
+ */
+void InterpolatePoses(const PoseBuffer& from, const PoseBuffer& to, float s, PoseBuffer& out, bool exact = true);
+
+/* Builds the matrix of every bone in @pose, as Matrix(scale, rotation, translation) would */
+void ComposePose(const PoseBuffer& pose, Matrix* out);
+
+}
+#endif
@@ -1,37 +1,66 @@
 #include <windows.h>
 #include <algorithm>
 #include "General/Utils.h"
+#include "General/ExactTypes.h"
 using namespace std;
 
 namespace Alamo
 {
 
-unsigned long crc32(const void *data, size_t size)
+// CRC-32 lookup tables for slicing-by-8, generated at compile time.
+// Table k holds the CRC of a byte followed by k zero bytes.
+struct CRC32Tables
 {
-    static unsigned long lookupTable[256];
-    static bool          validTable = false;
+    uint32_t table[8][256];
 
-	if (!validTable)
-	{
-        // Initialize table
-	    for (int i = 0; i < 256; i++)
+    constexpr CRC32Tables() : table()
+    {
+        for (int i = 0; i < 256; i++)
         {
-		    unsigned long crc = i;
+            uint32_t crc = i;
             for (int j = 0; j < 8; j++)
-		    {
-			    crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
-		    }
-            lookupTable[i] = crc & 0xFFFFFFFF;
-	    }
-	    validTable = true;
-	}
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+            }
+            table[0][i] = crc;
+        }
 
-	unsigned long crc = 0xFFFFFFFF;
-	for (size_t j = 0; j < size; j++)
-	{
-		crc = ((crc >> 8) & 0x00FFFFFF) ^ lookupTable[ (crc ^ ((const char*)data)[j]) & 0xFF ];
-	}
-	return crc ^ 0xFFFFFFFF;
+        for (int i = 0; i < 256; i++)
+        {
+            for (int k = 1; k < 8; k++)
+            {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+static constexpr CRC32Tables CRC32 = CRC32Tables();
+
+unsigned long crc32(const void *data, size_t size)
+{
+    const uint32_t (&table)[8][256] = CRC32.table;
+    const uint8_t* p   = (const uint8_t*)data;
+    uint32_t       crc = 0xFFFFFFFF;
+
+    // Eight bytes at a time
+    for (; size >= 8; p += 8, size -= 8)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, p,     sizeof(uint32_t));
+        memcpy(&hi, p + 4, sizeof(uint32_t));
+        lo = letohl(lo) ^ crc;
+        hi = letohl(hi);
+        crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^ table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24]
+            ^ table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^ table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+    }
+
+    // And the rest one at a time
+    for (; size > 0; p++, size--)
+    {
+        crc = (crc >> 8) ^ table[0][(crc ^ *p) & 0xFF];
+    }
+    return crc ^ 0xFFFFFFFF;
 }
 
 // Convert an ANSI string to a wide (UCS-2) string
@@ -146,7 +146,7 @@ LightFieldInstance::LightFieldInstance(const LightFieldSource& source, RenderObj
     }
 
     // Determine XY rotation of attached bone as initial rotation
-    const Vector3 dir = Vector4(1,0,0,0) * m_object.GetModel().GetBone(m_bone).absTransform;
+    const Vector3 dir = Vector4(1,0,0,0) * m_object.GetModel().GetAbsTransform(m_bone);
     m_rotation = atan2f(dir.y, dir.x);
 }
 
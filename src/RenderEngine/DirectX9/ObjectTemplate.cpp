@@ -62,8 +62,8 @@ void ObjectTemplate::DoBillboard(Matrix& world, const Model::Bone* bone) const
             if (bone != NULL)
             {
                 Matrix tmp = Matrix::Identity;
-                tmp.setTranslation(bone->absTransform.getTranslation() * matrices.m_billboardSun);
-                world = matrices.m_billboardView * tmp * bone->absTransform.inverse() * world;
+                tmp.setTranslation(m_model->GetAbsTransform(bone->index).getTranslation() * matrices.m_billboardSun);
+                world = matrices.m_billboardView * tmp * m_model->GetInvAbsTransform(bone->index) * world;
             }
             break;
     }
@@ -151,14 +151,11 @@ bool ObjectTemplate::SubMesh::Render(const RenderObject& object, bool special) c
 
     if (effect->GetSkinType() != SKIN_NONE)
     {
-        const Model& model = *m_template->GetModel();
-
         // Get bone poses
         Matrix skinArray[MAX_NUM_SKIN_BONES];
         for (unsigned int i = 0; i < m_subMesh->nSkinBones; i++)
         {
-            unsigned long bone = m_subMesh->skin[i];
-            skinArray[i] = model.GetBone(bone).invAbsTransform * object.GetBoneTransform(bone);
+            skinArray[i] = object.GetSkinTransform(m_subMesh->skin[i]);
         }
 
         if (software)
@@ -471,9 +468,16 @@ ObjectTemplate::ObjectTemplate(ptr<Model> model, RenderEngine& engine, VertexMan
                 submesh.m_debugEffect = engine.LoadShadowDebugEffect(submesh.m_effect->GetSkinType() != SKIN_NONE);
             }
 
-            VertexFormat format = submesh.m_effect->GetVertexFormat();
-            submesh.m_vertices = manager.CreateVertexBuffer(format, srcmesh.vertices, (DWORD)srcmesh.vertices.size());
-            submesh.m_indices  = manager.CreateIndexBuffer(srcmesh.indices, (DWORD)srcmesh.indices.size());
+            if (!srcmesh.UseVertexFormat(submesh.m_effect->GetVertexType()))
+            {
+                Log::WriteInfo("Mesh \"%s\" has vertex format \"%s\", but shader \"%s\" expects \"%s\"\n",
+                    mesh.name.c_str(), srcmesh.vertexFormat.c_str(), srcmesh.shader.c_str(), submesh.m_effect->GetVertexType().c_str());
+            }
+
+            VertexFormat    format   = submesh.m_effect->GetVertexFormat();
+            VERTEX_ELEMENTS vertices = srcmesh.GetVertices();
+            submesh.m_vertices = manager.CreateVertexBuffer(format, &vertices, (DWORD)srcmesh.nVertices);
+            submesh.m_indices  = manager.CreateIndexBuffer(srcmesh.GetIndices(), (DWORD)srcmesh.nIndices);
 
             // Load shader parameters
             submesh.m_parameters.resize(srcmesh.parameters.size());
@@ -955,6 +955,11 @@ ID3DXEffect* RenderEngine::LoadShader(const std::string& name, bool usePlacehold
             ShaderInclude inc(physfile->name());
             hRes = D3DXCreateEffectFromFile(m_pDevice, physfile->name().c_str(), Macros, &inc, D3DXFX_NOT_CLONEABLE | D3DXSHADER_ENABLE_BACKWARDS_COMPATIBILITY, NULL, &pEffect, &errors);
         }
+        else if (file->data() != NULL)
+        {
+            // Compile straight from the mapped MegaFile
+            hRes = D3DXCreateEffect(m_pDevice, file->data(), (UINT)file->size(), Macros, NULL, D3DXFX_NOT_CLONEABLE | D3DXSHADER_ENABLE_BACKWARDS_COMPATIBILITY, NULL, &pEffect, &errors);
+        }
         else
         {
             Buffer<char> data(file->size());
@@ -1074,12 +1079,19 @@ ptr<Texture> RenderEngine::LoadTexture(const std::string& name, bool usePlacehol
     ptr<IFile> file = Assets::LoadTexture(name);
     if (file != NULL)
     {
-        Buffer<char> data(file->size());
-        file->read(data, file->size());
+        // Use the file's memory directly if it's mapped, otherwise read it
+        Buffer<char> buffer;
+        const void*  data = file->data();
+        if (data == NULL)
+        {
+            buffer.resize(file->size());
+            file->read(buffer, file->size());
+            data = buffer;
+        }
         
         // Create the texture
         HRESULT hRes;
-        if (FAILED(hRes = D3DXCreateTextureFromFileInMemory(m_pDevice, data, (UINT)data.size(), &pD3DTexture)))
+        if (FAILED(hRes = D3DXCreateTextureFromFileInMemory(m_pDevice, data, (UINT)file->size(), &pD3DTexture)))
         {
             Log::WriteError("Unable to load texture \"%s\": %ls.\n", name.c_str(), DXGetErrorDescription(hRes));
         }
@@ -43,8 +43,9 @@ void RenderObject::SetColorization(const Color& color)
 
 void RenderObject::SetAnimation(const ptr<Animation> anim)
 {
-    m_animation = anim;
-    m_time      = 0.0f;
+    m_animation     = anim;
+    m_time          = 0.0f;
+    m_poseValid     = false;
 }
 
 void RenderObject::ResetAnimation()
@@ -70,13 +71,49 @@ void RenderObject::SetAnimationTime(float t)
     m_time     = t;
 }
 
+void RenderObject::UpdatePose() const
+{
+    if (m_poseValid && m_poseAnimation == m_animation && m_poseTime == m_time)
+    {
+        return;
+    }
+
+    const Model::Skeleton& skeleton = m_model.GetSkeleton();
+    if (m_animation != NULL)
+    {
+        m_animation->EvaluatePose(m_time, m_pose);
+    }
+    else for (size_t e = 0; e < m_pose.size(); e++)
+    {
+        m_pose[skeleton.bones[e]] = skeleton.absTransforms[e];
+    }
+
+    // Every submesh that is skinned to a bone shares its matrix
+    for (size_t e = 0; e < m_skin.size(); e++)
+    {
+        const size_t bone = skeleton.bones[e];
+        m_skin[bone] = skeleton.invAbsTransforms[e] * m_pose[bone];
+    }
+
+    m_poseValid     = true;
+    m_poseAnimation = m_animation;
+    m_poseTime      = m_time;
+}
+
 Matrix RenderObject::GetBoneTransform(size_t bone) const
 {
     if (m_animation != NULL)
     {
-        return m_animation->GetFrame(bone, m_time);
+        UpdatePose();
+        return m_pose[bone];
     }
-    return m_model.GetBone(bone).absTransform;
+    return m_model.GetAbsTransform(bone);
+}
+
+const Matrix& RenderObject::GetSkinTransform(size_t bone) const
+{
+    UpdatePose();
+    return m_skin[bone];
 }
 
 bool RenderObject::GetBoneVisibility(size_t bone) const
@@ -369,6 +406,10 @@ RenderObject::RenderObject(LinkedList<RenderObject> &objects, ptr<ObjectTemplate
 
     // Create the bones
     m_bones.resize(m_model.GetNumBones());
+    m_pose .resize(m_model.GetNumBones());
+    m_skin .resize(m_model.GetNumBones());
+    m_poseValid     = false;
+    m_poseAnimation = NULL;
     for (size_t i = 0; i < m_bones.size(); i++)
     {
         m_bones[i].m_visible = true;
@@ -61,6 +61,13 @@ private:
     float                     m_time;
     float                     m_prevTime;
 
+    // The bone transforms and skinning matrices, evaluated once per animation and time
+    mutable Buffer<Matrix>    m_pose;
+    mutable Buffer<Matrix>    m_skin;
+    mutable bool              m_poseValid;
+    mutable const Animation*  m_poseAnimation;
+    mutable float             m_poseTime;
+
     void SpawnProxy(size_t index, float time);
     void KillProxy(size_t index);
     void CheckAltLod(bool altdesc);
@@ -102,12 +109,14 @@ public:
     void RenderBones() const;
     void RenderDazzles() const;
     void Update();
+    void UpdatePose() const;
 
     const IObjectTemplate*  GetTemplate()                  const { return m_templ; }
     const Model&            GetModel()                     const { return m_model; }
     const SubMesh*          GetMesh(RenderPhase phase)     const { return m_meshlist[phase]; }
     const Color&            GetColorization()              const { return m_colorization; }
     Matrix                  GetBoneTransform(size_t bone)  const;
+    const Matrix&           GetSkinTransform(size_t bone)  const;   // From the model's rest pose to the bone's current pose
     bool                    GetBoneVisibility(size_t bone) const;
 
     RenderObject(LinkedList<RenderObject> &objects, ptr<ObjectTemplate> templ, int alt, int lod);
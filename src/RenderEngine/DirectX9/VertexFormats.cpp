@@ -242,60 +242,60 @@ static Vector2 Pack_UV(const Vector2& texCoord)
 static void VertProcN(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_MESH_N* dest = (VERTEX_MESH_N*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position = src->Position;
-        dest->Normal   = src->Normal;
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position = src.Position[i];
+        dest->Normal   = src.Normal[i];
     }
 }
 
 static void VertProcNU2(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_MESH_NU2* dest = (VERTEX_MESH_NU2*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position = src->Position;
-        dest->Normal   = src->Normal;
-        dest->TexCoord = src->TexCoord[0];
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position = src.Position[i];
+        dest->Normal   = src.Normal[i];
+        dest->TexCoord = src.TexCoord[0][i];
     }
 }
 
 static void VertProcNU2C(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_MESH_NU2C* dest = (VERTEX_MESH_NU2C*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position = src->Position;
-        dest->Normal   = src->Normal;
-        dest->Color    = D3DCOLOR_COLORVALUE(src->Color.r, src->Color.g, src->Color.b, src->Color.a);
-        dest->TexCoord = src->TexCoord[0];
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position = src.Position[i];
+        dest->Normal   = src.Normal[i];
+        dest->Color    = D3DCOLOR_COLORVALUE(src.Color[i].r, src.Color[i].g, src.Color[i].b, src.Color[i].a);
+        dest->TexCoord = src.TexCoord[0][i];
     }
 }
 
 static void VertProcNU2U3U3(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_MESH_NU2U3U3* dest = (VERTEX_MESH_NU2U3U3*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position = src->Position;
-        dest->Normal   = src->Normal;
-        dest->TexCoord = src->TexCoord[0];
-        dest->Tangent  = src->Tangent;
-        dest->Binormal = src->Binormal;
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position = src.Position[i];
+        dest->Normal   = src.Normal[i];
+        dest->TexCoord = src.TexCoord[0][i];
+        dest->Tangent  = src.Tangent[i];
+        dest->Binormal = src.Binormal[i];
     }
 }
 
 static void VertProcNU2U3U3C(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_MESH_NU2U3U3C* dest = (VERTEX_MESH_NU2U3U3C*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position = src->Position;
-        dest->Normal   = src->Normal;
-        dest->Color    = D3DCOLOR_COLORVALUE(src->Color.r, src->Color.g, src->Color.b, src->Color.a);
-        dest->TexCoord = src->TexCoord[0];
-        dest->Tangent  = src->Tangent;
-        dest->Binormal = src->Binormal;
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position = src.Position[i];
+        dest->Normal   = src.Normal[i];
+        dest->Color    = D3DCOLOR_COLORVALUE(src.Color[i].r, src.Color[i].g, src.Color[i].b, src.Color[i].a);
+        dest->TexCoord = src.TexCoord[0][i];
+        dest->Tangent  = src.Tangent[i];
+        dest->Binormal = src.Binormal[i];
     }
 }
 
@@ -313,12 +313,12 @@ static void VertProcRSkinNU2_HW(void* _dest, const void* _src, DWORD num, bool i
 static void VertProcRSkinNU2_SW(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_RSKIN_NU2_SW* dest = (VERTEX_RSKIN_NU2_SW*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position     = src->Position;
-        dest->BlendIndices = src->BoneIndices[0];
-        dest->Normal       = src->Normal;
-        dest->TexCoord     = src->TexCoord[0];
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position     = src.Position[i];
+        dest->BlendIndices = src.BoneIndices[0][i];
+        dest->Normal       = src.Normal[i];
+        dest->TexCoord     = src.TexCoord[0][i];
     }
 }
 
@@ -337,13 +337,13 @@ static void VertProcRSkinNU2C_HW(void* _dest, const void* _src, DWORD num, bool
 static void VertProcRSkinNU2C_SW(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_RSKIN_NU2C_SW* dest = (VERTEX_RSKIN_NU2C_SW*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position     = src->Position;
-        dest->BlendIndices = src->BoneIndices[0];
-        dest->Normal       = src->Normal;
-        dest->TexCoord     = src->TexCoord[0];
-        dest->Color        = D3DCOLOR_COLORVALUE(src->Color.r, src->Color.g, src->Color.b, src->Color.a);
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position     = src.Position[i];
+        dest->BlendIndices = src.BoneIndices[0][i];
+        dest->Normal       = src.Normal[i];
+        dest->TexCoord     = src.TexCoord[0][i];
+        dest->Color        = D3DCOLOR_COLORVALUE(src.Color[i].r, src.Color[i].g, src.Color[i].b, src.Color[i].a);
     }
 }
 
@@ -363,14 +363,14 @@ static void VertProcRSkinNU2U3U3_HW(void* _dest, const void* _src, DWORD num, bo
 static void VertProcRSkinNU2U3U3_SW(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_RSKIN_NU2U3U3_SW* dest = (VERTEX_RSKIN_NU2U3U3_SW*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position     = src->Position;
-        dest->BlendIndices = src->BoneIndices[0];
-        dest->Normal       = src->Normal;
-        dest->TexCoord     = src->TexCoord[0];
-        dest->Tangent      = src->Tangent;
-        dest->Binormal     = src->Binormal;
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position     = src.Position[i];
+        dest->BlendIndices = src.BoneIndices[0][i];
+        dest->Normal       = src.Normal[i];
+        dest->TexCoord     = src.TexCoord[0][i];
+        dest->Tangent      = src.Tangent[i];
+        dest->Binormal     = src.Binormal[i];
     }
 }
 
@@ -391,15 +391,15 @@ static void VertProcRSkinNU2U3U3C_HW(void* _dest, const void* _src, DWORD num, b
 static void VertProcRSkinNU2U3U3C_SW(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_RSKIN_NU2U3U3C_SW* dest = (VERTEX_RSKIN_NU2U3U3C_SW*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position     = src->Position;
-        dest->BlendIndices = src->BoneIndices[0];
-        dest->Normal       = src->Normal;
-        dest->Color        = D3DCOLOR_COLORVALUE(src->Color.r, src->Color.g, src->Color.b, src->Color.a);
-        dest->TexCoord     = src->TexCoord[0];
-        dest->Tangent      = src->Tangent;
-        dest->Binormal     = src->Binormal;
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position     = src.Position[i];
+        dest->BlendIndices = src.BoneIndices[0][i];
+        dest->Normal       = src.Normal[i];
+        dest->Color        = D3DCOLOR_COLORVALUE(src.Color[i].r, src.Color[i].g, src.Color[i].b, src.Color[i].a);
+        dest->TexCoord     = src.TexCoord[0][i];
+        dest->Tangent      = src.Tangent[i];
+        dest->Binormal     = src.Binormal[i];
     }
 }
 
@@ -419,13 +419,13 @@ static void VertProcSkinNU2_HW(void* _dest, const void* _src, DWORD num, bool is
 static void VertProcSkinNU2_SW(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_SKIN_NU2_SW* dest = (VERTEX_SKIN_NU2_SW*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position     = src->Position;
-        dest->BlendWeights = Vector3(src->BoneWeights[0], src->BoneWeights[1], src->BoneWeights[2]);
-        dest->BlendIndices = (src->BoneIndices[0] << 0) | (src->BoneIndices[1] << 8) | (src->BoneIndices[2] << 16) | (src->BoneIndices[3] << 24);
-        dest->Normal       = src->Normal;
-        dest->TexCoord     = src->TexCoord[0];
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position     = src.Position[i];
+        dest->BlendWeights = Vector3(src.BoneWeights[0][i], src.BoneWeights[1][i], src.BoneWeights[2][i]);
+        dest->BlendIndices = (src.BoneIndices[0][i] << 0) | (src.BoneIndices[1][i] << 8) | (src.BoneIndices[2][i] << 16) | (src.BoneIndices[3][i] << 24);
+        dest->Normal       = src.Normal[i];
+        dest->TexCoord     = src.TexCoord[0][i];
     }
 }
 
@@ -446,14 +446,14 @@ static void VertProcSkinNU2C_HW(void* _dest, const void* _src, DWORD num, bool i
 static void VertProcSkinNU2C_SW(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_SKIN_NU2C_SW* dest = (VERTEX_SKIN_NU2C_SW*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position     = src->Position;
-        dest->BlendWeights = Vector3(src->BoneWeights[0], src->BoneWeights[1], src->BoneWeights[2]);
-        dest->BlendIndices = (src->BoneIndices[0] << 0) | (src->BoneIndices[1] << 8) | (src->BoneIndices[2] << 16) | (src->BoneIndices[3] << 24);
-        dest->Normal       = src->Normal;
-        dest->TexCoord     = src->TexCoord[0];
-        dest->Color        = D3DCOLOR_COLORVALUE(src->Color.r, src->Color.g, src->Color.b, src->Color.a);
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position     = src.Position[i];
+        dest->BlendWeights = Vector3(src.BoneWeights[0][i], src.BoneWeights[1][i], src.BoneWeights[2][i]);
+        dest->BlendIndices = (src.BoneIndices[0][i] << 0) | (src.BoneIndices[1][i] << 8) | (src.BoneIndices[2][i] << 16) | (src.BoneIndices[3][i] << 24);
+        dest->Normal       = src.Normal[i];
+        dest->TexCoord     = src.TexCoord[0][i];
+        dest->Color        = D3DCOLOR_COLORVALUE(src.Color[i].r, src.Color[i].g, src.Color[i].b, src.Color[i].a);
     }
 }
 
@@ -475,15 +475,15 @@ static void VertProcSkinNU2U3U3_HW(void* _dest, const void* _src, DWORD num, boo
 static void VertProcSkinNU2U3U3_SW(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_SKIN_NU2U3U3_SW* dest = (VERTEX_SKIN_NU2U3U3_SW*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position     = src->Position;
-        dest->BlendWeights = Vector3(src->BoneWeights[0], src->BoneWeights[1], src->BoneWeights[2]);
-        dest->BlendIndices = (src->BoneIndices[0] << 0) | (src->BoneIndices[1] << 8) | (src->BoneIndices[2] << 16) | (src->BoneIndices[3] << 24);
-        dest->Normal       = src->Normal;
-        dest->TexCoord     = src->TexCoord[0];
-        dest->Tangent      = src->Tangent;
-        dest->Binormal     = src->Binormal;
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position     = src.Position[i];
+        dest->BlendWeights = Vector3(src.BoneWeights[0][i], src.BoneWeights[1][i], src.BoneWeights[2][i]);
+        dest->BlendIndices = (src.BoneIndices[0][i] << 0) | (src.BoneIndices[1][i] << 8) | (src.BoneIndices[2][i] << 16) | (src.BoneIndices[3][i] << 24);
+        dest->Normal       = src.Normal[i];
+        dest->TexCoord     = src.TexCoord[0][i];
+        dest->Tangent      = src.Tangent[i];
+        dest->Binormal     = src.Binormal[i];
     }
 }
 
@@ -506,48 +506,48 @@ static void VertProcSkinNU2U3U3C_HW(void* _dest, const void* _src, DWORD num, bo
 static void VertProcSkinNU2U3U3C_SW(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_SKIN_NU2U3U3C_SW* dest = (VERTEX_SKIN_NU2U3U3C_SW*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position     = src->Position;
-        dest->BlendWeights = Vector3(src->BoneWeights[0], src->BoneWeights[1], src->BoneWeights[2]);
-        dest->BlendIndices = (src->BoneIndices[0] << 0) | (src->BoneIndices[1] << 8) | (src->BoneIndices[2] << 16) | (src->BoneIndices[3] << 24);
-        dest->Normal       = src->Normal;
-        dest->Color        = D3DCOLOR_COLORVALUE(src->Color.r, src->Color.g, src->Color.b, src->Color.a);
-        dest->TexCoord     = src->TexCoord[0];
-        dest->Tangent      = src->Tangent;
-        dest->Binormal     = src->Binormal;
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position     = src.Position[i];
+        dest->BlendWeights = Vector3(src.BoneWeights[0][i], src.BoneWeights[1][i], src.BoneWeights[2][i]);
+        dest->BlendIndices = (src.BoneIndices[0][i] << 0) | (src.BoneIndices[1][i] << 8) | (src.BoneIndices[2][i] << 16) | (src.BoneIndices[3][i] << 24);
+        dest->Normal       = src.Normal[i];
+        dest->Color        = D3DCOLOR_COLORVALUE(src.Color[i].r, src.Color[i].g, src.Color[i].b, src.Color[i].a);
+        dest->TexCoord     = src.TexCoord[0][i];
+        dest->Tangent      = src.Tangent[i];
+        dest->Binormal     = src.Binormal[i];
     }
 }
 
 static void VertProcGrass(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_GRASS* dest = (VERTEX_GRASS*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position    = src->Position;
-        dest->TexCoord    = Pack_UV(src->TexCoord[0]);
-        dest->ClumpCenter = src->TexCoord[1];
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position    = src.Position[i];
+        dest->TexCoord    = Pack_UV(src.TexCoord[0][i]);
+        dest->ClumpCenter = src.TexCoord[1][i];
     }
 }
 
 static void VertProcBillboard(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX_BILLBOARD* dest = (VERTEX_BILLBOARD*)_dest;
-    MASTER_VERTEX*    src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position = src->Position;
-        dest->Normal   = src->Normal;
-        dest->TexCoord = Pack_UV(src->TexCoord[0]);
-        dest->Center   = Vector3(src->BoneWeights);
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position = src.Position[i];
+        dest->Normal   = src.Normal[i];
+        dest->TexCoord = Pack_UV(src.TexCoord[0][i]);
+        dest->Center   = Vector3(src.BoneWeights[0][i], src.BoneWeights[1][i], src.BoneWeights[2][i]);
     }
 }
 
 static void VertProc(void* _dest, const void* _src, DWORD num, bool isUaW)
 {
     VERTEX* dest = (VERTEX*)_dest;
-    MASTER_VERTEX* src  = (MASTER_VERTEX*)_src;
-    for (DWORD i = 0; i < num; i++, dest++, src++) {
-        dest->Position = src->Position;
+    const VERTEX_ELEMENTS& src  = *(const VERTEX_ELEMENTS*)_src;
+    for (DWORD i = 0; i < num; i++, dest++) {
+        dest->Position = src.Position[i];
     }
 }
 
@@ -287,6 +287,8 @@ struct VERTEX_TRACK
 
 #pragma pack()
 
+// Converts vertices to the format. The SW procs of the model formats read a
+// VERTEX_ELEMENTS, the others read the vertices in the format itself.
 typedef void (*VertexProc)(void* dest, const void* src, DWORD num, bool isUaW);
 
 struct VertexFormatResourceInfo
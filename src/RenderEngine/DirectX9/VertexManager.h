@@ -128,7 +128,9 @@ public:
     /* Adds the specified vertices in the specified format to a vertex buffer.
      * @format: Format of the vertices in the vertex array. You can get a predefined
      *          vertex format from a description string with GetVertexFormat().
-     * @data:   Pointer to the vertex array.
+     * @data:   Pointer to the vertex array. For the model formats (up to and
+     *          including VF_BILLBOARD, and VF_GENERIC) this is a pointer to a
+     *          VERTEX_ELEMENTS instead.
      * @num:    Number of vertices. Multiplied with the size of vertex (as derived
      *          from the format) this yields the byte-size of the @data array.
      */
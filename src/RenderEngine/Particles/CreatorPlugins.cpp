@@ -516,66 +516,96 @@ TorusCreatorPlugin::TorusCreatorPlugin(ParticleSystem::Emitter& emitter)
 //
 struct MeshCreatorBase::MeshCreatorData
 {
-    const IRenderObject* m_object;
-    const Model::Mesh*   m_mesh;
-    size_t               m_subMesh;
-    size_t               m_vertex;
+    const IRenderObject*  m_object;
+    const Model::Mesh*    m_mesh;
+    const SurfaceSampler* m_sampler;
+    size_t                m_subMesh;
+    size_t                m_vertex;
+    uint64_t              m_random;
 };
 
+// xorshift64*; cheaper than rand() and gives the sampler a full 64 bits per call
+static uint64_t NextRandom(uint64_t& state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+void MeshCreatorBase::InitializeMeshInstance(MeshCreatorData* data, IRenderObject* object, const Model::Mesh* mesh) const
+{
+    data->m_object  = object;
+    data->m_mesh    = mesh;
+    data->m_sampler = NULL;
+    data->m_vertex  = 0;
+    data->m_subMesh = 0;
+    data->m_random  = ((uint64_t)rand() << 48) ^ ((uint64_t)rand() << 32) ^ ((uint64_t)rand() << 16) ^ rand() ^ (uintptr_t)data;
+    if (data->m_random == 0)
+    {
+        // xorshift never leaves zero
+        data->m_random = 1;
+    }
+
+    if (mesh != NULL && m_spawnLocation == MESH_RANDOM_SURFACE)
+    {
+        // Build it now rather than on the first spawn; the mesh keeps it for other instances
+        data->m_sampler = &mesh->GetSurfaceSampler();
+    }
+}
+
 void MeshCreatorBase::InitializeParticle(Particle* p, MeshCreatorData* data) const
 {
     p->position = Vector3(0,0,0);
     if (data->m_mesh != NULL)
     {
         const Model::Mesh*  mesh = data->m_mesh;
-        MASTER_VERTEX tmp;
-        const MASTER_VERTEX* v = &tmp;
+        Vector3 vertexPosition(0,0,0);
+        Vector3 vertexNormal(0,0,0);
         switch (m_spawnLocation)
         {
-            case MESH_ALL_VERTICES:
-                v = &mesh->subMeshes[data->m_subMesh].vertices[data->m_vertex];
+            case MESH_ALL_VERTICES: {
+                const VERTEX_ELEMENTS vertices = mesh->subMeshes[data->m_subMesh].GetVertices();
+                vertexPosition = vertices.Position[data->m_vertex];
+                vertexNormal   = vertices.Normal  [data->m_vertex];
                 // Go to next vertex
-                if (++data->m_vertex == mesh->subMeshes[data->m_subMesh].vertices.size())
+                if (++data->m_vertex == mesh->subMeshes[data->m_subMesh].nVertices)
                 {
                     data->m_vertex  = 0;
                     data->m_subMesh = (data->m_subMesh + 1) % mesh->subMeshes.size();
                 }
                 break;
+            }
 
             case MESH_RANDOM_VERTEX: {
                 // Pick random submesh and vertex
                 int subMesh = GetRandom(0, (int)mesh->subMeshes.size());
-                int vertex  = GetRandom(0, (int)mesh->subMeshes[subMesh].vertices.size());
-                v = &mesh->subMeshes[subMesh].vertices[vertex];
+                int vertex  = GetRandom(0, (int)mesh->subMeshes[subMesh].nVertices);
+                const VERTEX_ELEMENTS vertices = mesh->subMeshes[subMesh].GetVertices();
+                vertexPosition = vertices.Position[vertex];
+                vertexNormal   = vertices.Normal  [vertex];
                 break;
             }
 
             case MESH_RANDOM_SURFACE: {
-                // Pick random submesh
-                int subMesh = GetRandom(0, (int)mesh->subMeshes.size());
-                const Model::SubMesh& submesh = mesh->subMeshes[subMesh];
-
-                // Pick random face on submesh
-                int face    = GetRandom(0, (int)submesh.indices.size() / 3) * 3;
-                const MASTER_VERTEX& v1 = submesh.vertices[submesh.indices[face + 0]];
-                const MASTER_VERTEX& v2 = submesh.vertices[submesh.indices[face + 1]];
-                const MASTER_VERTEX& v3 = submesh.vertices[submesh.indices[face + 2]];
-
-                // Pick random position on face (barycentric coordinates)
-                float w1 = GetRandom(0.0f, 1.0f);
-                float w2 = GetRandom(0.0f, 1.0f - w1);
-                float w3 = 1.0f - w2 - w1;
-
-                tmp.Position = v1.Position * w1 + v2.Position * w2 + v3.Position * w3;
-                tmp.Normal   = v1.Normal   * w1 + v2.Normal   * w2 + v3.Normal   * w3;
+                // Pick an area-weighted random position on the surface
+                SurfaceSampler::Sample sample;
+                uint64_t random1 = NextRandom(data->m_random);
+                uint64_t random2 = NextRandom(data->m_random);
+                if (data->m_sampler->GetSample(random1, random2, &sample))
+                {
+                    const VERTEX_ELEMENTS vertices = mesh->subMeshes[sample.subMesh].GetVertices();
+                    vertexPosition = vertices.Position[sample.v[0]] * sample.w[0] + vertices.Position[sample.v[1]] * sample.w[1] + vertices.Position[sample.v[2]] * sample.w[2];
+                    vertexNormal   = vertices.Normal  [sample.v[0]] * sample.w[0] + vertices.Normal  [sample.v[1]] * sample.w[1] + vertices.Normal  [sample.v[2]] * sample.w[2];
+                }
                 break;
             }
         }
 
-        // Initialize particle based on vertex v
+        // Initialize particle based on the vertex
         const Matrix transform = data->m_object->GetBoneTransform(mesh->bone->index);
-        Vector3 normal   = Vector4(v->Normal,   0) * transform;
-        Vector3 position = Vector4(v->Position, 1) * transform;
+        Vector3 normal   = Vector4(vertexNormal,   0) * transform;
+        Vector3 position = Vector4(vertexPosition, 1) * transform;
         
         p->position = position + normal * m_surfaceOffset;
         if (m_alignVelocityToNormal)
@@ -652,11 +682,7 @@ size_t MeshCreatorPlugin::GetPrivateDataSize() const
 
 void MeshCreatorPlugin::InitializeInstance(void* data, IRenderObject* object, const Model::Mesh* mesh) const
 {
-    MeshCreatorData* mcd = (MeshCreatorData*)data;
-    mcd->m_object  = object;
-    mcd->m_mesh    = mesh;
-    mcd->m_vertex  = 0;
-    mcd->m_subMesh = 0;
+    InitializeMeshInstance((MeshCreatorData*)data, object, mesh);
 }
 
 ParticleSystem::Emitter* MeshCreatorPlugin::Initialize()
@@ -1061,11 +1087,7 @@ void EnhancedMeshCreatorPlugin::InitializeParticle(Particle* p, void* data, cons
 
 void EnhancedMeshCreatorPlugin::InitializeInstance(void* data, IRenderObject* object, const Model::Mesh* mesh) const
 {
-    MeshCreatorData* mcd = (MeshCreatorData*)data;
-    mcd->m_object  = object;
-    mcd->m_mesh    = mesh;
-    mcd->m_vertex  = 0;
-    mcd->m_subMesh = 0;
+    InitializeMeshInstance((MeshCreatorData*)data, object, mesh);
 }
 
 EnhancedMeshCreatorPlugin::EnhancedMeshCreatorPlugin(ParticleSystem::Emitter& emitter)
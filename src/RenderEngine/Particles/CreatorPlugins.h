@@ -175,6 +175,7 @@ protected:
     float         m_surfaceOffset;
 
     void InitializeParticle(Particle* p, MeshCreatorData* data) const;
+    void InitializeMeshInstance(MeshCreatorData* data, IRenderObject* object, const Model::Mesh* mesh) const;
     MeshCreatorBase();
 };
 
@@ -12,8 +12,7 @@ namespace Alamo
 
 class ListBase : public PluginProperty
 {
-    virtual void ReadItem(ChunkReader& reader) = 0;
-    virtual void Reserve(size_t count) = 0;
+    virtual void ReadItems(ChunkReader& reader, size_t count) = 0;
     void Read(ChunkReader& reader);
 };
 
@@ -31,8 +30,14 @@ struct List : public ListBase
         m_data.reserve(count);
     }
 
-    void ReadItem(ChunkReader& reader) {
-        m_data.push_back(TemplateReader<T>::read(reader));
+    void ReadItems(ChunkReader& reader, size_t count) {
+        // Read all items' floats at once, then convert them
+        Buffer<float> values(count * TemplateReader<T>::NUM_FLOATS);
+        reader.readArray((float*)values, values.size());
+        m_data.reserve(m_data.size() + count);
+        for (size_t i = 0; i < count; i++) {
+            m_data.push_back(TemplateReader<T>::unpack(values + i * TemplateReader<T>::NUM_FLOATS));
+        }
     }
 
     void push_back(const T& val) { m_data.push_back(val); }
@@ -9,11 +9,7 @@ namespace Alamo
 void ListBase::Read(ChunkReader& reader)
 {
     unsigned long count = reader.readInteger();
-    Reserve(count);
-    for (unsigned long i = 0; i < count; i++)
-    {
-        ReadItem(reader);
-    }
+    ReadItems(reader, count);
 }
 
 //
@@ -35,8 +35,11 @@ static const unsigned long WAVE_ID = 0x45564157;    // "WAVE"
 static const unsigned long FMT_ID  = 0x20746D66;    // "fmt "
 static const unsigned long DATA_ID = 0x61746164;    // "data"
 
-WaveFile::WaveFile(ptr<IFile> file)
+WaveFile::WaveFile(ptr<IFile> _file)
 {
+    // Buffer the chunk header reads
+    ptr<IFile> file = MakeBuffered(_file);
+
     // Read and check root RIFF chunk
     ROOTCHUNK root;
     if (file->read(&root, sizeof root) != sizeof root)
@@ -500,7 +500,7 @@ static void LoadFile(ApplicationInfo* info, wstring filename)
 	            if (pos != string::npos)
 	            {
 		            // It's an MEG:Filename pair
-		            file = new PhysicalFile(filename.substr(0, pos));
+		            file = OpenMappedFile(filename.substr(0, pos));
 		            meg  = new MegaFile(file);
 
                     file = meg->GetFile(WideToAnsi(filename.substr(pos + 1)));